@@ -0,0 +1,281 @@
+// Opt-in Vulkan smoke run (WM_BUILD_VULKAN_SMOKE): creates a window, a
+// VulkanWindowSurface and its swapchain, then acquires, clears and presents
+// frames while forcing swapchain recreation. Any compositor resize is picked
+// up by acquire() along the way. Works on a software driver such as lavapipe.
+#include "window_manager/wayland_backend.hpp"
+#include "window_manager/vulkan_surface.hpp"
+
+#include <array>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr int FRAME_COUNT = 240;
+// Every this many frames the smoke run suspends, resumes or invalidates.
+constexpr int RECREATE_INTERVAL = 60;
+
+struct Device {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physical = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+
+    ~Device()
+    {
+        if (device) vkDestroyDevice(device, nullptr);
+        if (instance) vkDestroyInstance(instance, nullptr);
+    }
+};
+
+bool create_device(Device &dev, std::span<const char *const> instanceExtensions)
+{
+    VkApplicationInfo app{};
+    app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app.pApplicationName = "window_manager vulkan smoke";
+    app.apiVersion = VK_API_VERSION_1_1;
+
+    VkInstanceCreateInfo instanceInfo{};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &app;
+    instanceInfo.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
+    instanceInfo.ppEnabledExtensionNames = instanceExtensions.data();
+    if (vkCreateInstance(&instanceInfo, nullptr, &dev.instance) != VK_SUCCESS) return false;
+
+    uint32_t count = 0;
+    vkEnumeratePhysicalDevices(dev.instance, &count, nullptr);
+    std::vector<VkPhysicalDevice> physicals(count);
+    vkEnumeratePhysicalDevices(dev.instance, &count, physicals.data());
+
+    // Presentation support is checked once the surface exists; a graphics
+    // queue is enough to pick the device.
+    for (const VkPhysicalDevice physical : physicals) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical, &familyCount, families.data());
+        for (uint32_t i = 0; i < familyCount; ++i) {
+            if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                dev.physical = physical;
+                dev.queueFamily = i;
+                break;
+            }
+        }
+        if (dev.physical) break;
+    }
+    if (!dev.physical) return false;
+
+    const float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo{};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = dev.queueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+
+    const char *const deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    VkDeviceCreateInfo deviceInfo{};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    deviceInfo.enabledExtensionCount = 1;
+    deviceInfo.ppEnabledExtensionNames = deviceExtensions;
+    if (vkCreateDevice(dev.physical, &deviceInfo, nullptr, &dev.device) != VK_SUCCESS) return false;
+
+    vkGetDeviceQueue(dev.device, dev.queueFamily, 0, &dev.queue);
+    return true;
+}
+
+// Moves the image to TRANSFER_DST, clears it and hands it to the presentation
+// engine; enough to make every present valid without a render pass.
+void record_clear(VkCommandBuffer cmd, VkImage image, const VkClearColorValue &color)
+{
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &begin);
+
+    VkImageSubresourceRange range{};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.levelCount = 1;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdClearColorImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1, &range);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkEndCommandBuffer(cmd);
+}
+
+}
+
+int main(int, char **)
+{
+    wm::wayland_window_manager manager;
+    manager.setErrorCallback([](wm::WmError err, const std::string &msg) {
+        std::fprintf(stderr, "[WM ERROR] %d: %s\n", static_cast<int>(err), msg.c_str());
+    });
+
+    auto window = manager.createWindow(640, 400, "Vulkan Smoke");
+    if (!window) {
+        std::fprintf(stderr, "Failed to create window\n");
+        return 1;
+    }
+    window.show();
+
+    Device dev;
+    if (!create_device(dev, manager.getVulkanInstanceExtensions())) {
+        std::fprintf(stderr, "Failed to create a Vulkan device\n");
+        return 1;
+    }
+
+    wm::VulkanDispatch dispatch;
+    if (!dispatch.load(dev.instance, dev.device)) {
+        std::fprintf(stderr, "Failed to load swapchain entry points\n");
+        return 1;
+    }
+
+    wm::VulkanSwapchainConfig config{};
+    config.physicalDevice = dev.physical;
+    config.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    config.presentMode = wm::PresentModePreference::Vsync;
+
+    wm::VulkanWindowSurface surface;
+    if (surface.init(manager, window, dispatch, config) != VK_SUCCESS) {
+        std::fprintf(stderr, "Failed to create the window surface\n");
+        return 1;
+    }
+    VkBool32 presentable = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(dev.physical, dev.queueFamily, surface.surface(), &presentable);
+    if (!presentable) {
+        std::fprintf(stderr, "Queue family %u cannot present to the surface\n", dev.queueFamily);
+        return 1;
+    }
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = dev.queueFamily;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    vkCreateCommandPool(dev.device, &poolInfo, nullptr, &pool);
+
+    VkCommandBufferAllocateInfo cmdInfo{};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdInfo.commandPool = pool;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandBufferCount = 1;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    vkAllocateCommandBuffers(dev.device, &cmdInfo, &cmd);
+
+    VkSemaphoreCreateInfo semInfo{};
+    semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkSemaphore acquired = VK_NULL_HANDLE;
+    VkSemaphore rendered = VK_NULL_HANDLE;
+    vkCreateSemaphore(dev.device, &semInfo, nullptr, &acquired);
+    vkCreateSemaphore(dev.device, &semInfo, nullptr, &rendered);
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkFence inFlight = VK_NULL_HANDLE;
+    vkCreateFence(dev.device, &fenceInfo, nullptr, &inFlight);
+
+    int presented = 0;
+    int failures = 0;
+    uint64_t generation = 0;
+    for (int frame = 0; frame < FRAME_COUNT && !window.shouldClose(); ++frame) {
+        manager.pollEvents([](wm::wayland_backend::window_type &win, const wm::WmEvent ev) {
+            if (ev == wm::WmEvent::WindowResized) {
+                std::fprintf(stderr, "[SMOKE] resized to %dx%d\n", win.getWidth(), win.getHeight());
+            }
+        });
+
+        // One frame in flight, so retired swapchains are always safe to drop.
+        vkWaitForFences(dev.device, 1, &inFlight, VK_TRUE, UINT64_MAX);
+
+        switch ((frame / RECREATE_INTERVAL) % 3) {
+            case 1:
+                if (frame % RECREATE_INTERVAL == 0) surface.invalidate();
+                break;
+            case 2:
+                if (frame % RECREATE_INTERVAL == 0) {
+                    surface.suspend();
+                    surface.resume();
+                }
+                break;
+            default:
+                break;
+        }
+
+        uint32_t imageIndex = 0;
+        VkResult res = surface.acquire(UINT64_MAX, acquired, VK_NULL_HANDLE, &imageIndex);
+        if (res == VK_NOT_READY || res == VK_ERROR_OUT_OF_DATE_KHR) continue;
+        if (res != VK_SUCCESS) {
+            std::fprintf(stderr, "acquire failed: %d\n", static_cast<int>(res));
+            ++failures;
+            break;
+        }
+        if (surface.generation() != generation) {
+            generation = surface.generation();
+            std::fprintf(stderr, "[SMOKE] swapchain #%llu %ux%u, %zu images\n",
+                         static_cast<unsigned long long>(generation), surface.extent().width,
+                         surface.extent().height, surface.images().size());
+        }
+
+        const float shade = static_cast<float>(frame % RECREATE_INTERVAL) / RECREATE_INTERVAL;
+        vkResetFences(dev.device, 1, &inFlight);
+        vkResetCommandBuffer(cmd, 0);
+        record_clear(cmd, surface.images()[imageIndex], VkClearColorValue{{shade, 0.2f, 1.0f - shade, 1.0f}});
+
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo submit{};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.waitSemaphoreCount = 1;
+        submit.pWaitSemaphores = &acquired;
+        submit.pWaitDstStageMask = &waitStage;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &cmd;
+        submit.signalSemaphoreCount = 1;
+        submit.pSignalSemaphores = &rendered;
+        vkQueueSubmit(dev.queue, 1, &submit, inFlight);
+
+        const std::array waits{rendered};
+        res = surface.present(dev.queue, imageIndex, waits);
+        if (res == VK_SUCCESS || res == VK_SUBOPTIMAL_KHR || res == VK_ERROR_OUT_OF_DATE_KHR) {
+            ++presented;
+        } else {
+            std::fprintf(stderr, "present failed: %d\n", static_cast<int>(res));
+            ++failures;
+            break;
+        }
+    }
+
+    vkDeviceWaitIdle(dev.device);
+    std::fprintf(stderr, "[SMOKE] %d frames presented across %llu swapchains\n",
+                 presented, static_cast<unsigned long long>(generation));
+
+    surface.destroy();
+    vkDestroyFence(dev.device, inFlight, nullptr);
+    vkDestroySemaphore(dev.device, rendered, nullptr);
+    vkDestroySemaphore(dev.device, acquired, nullptr);
+    vkDestroyCommandPool(dev.device, pool, nullptr);
+    return failures == 0 && presented > 0 ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "window_manager/window_manager.hpp"
+
+namespace wm {
+
+// Statically dispatched front end. A Backend policy provides
+//
+//   using manager_type = ...;  // final class implementing wm::WindowManager
+//   using window_type  = ...;  // final class implementing wm::Window
+//   static std::unique_ptr<manager_type> create(std::pmr::memory_resource *);
+//
+// Every call below is qualified with the concrete type, so nothing goes
+// through the vtable and accessors inline into the caller. The polymorphic
+// wm::WindowManager / wm::Window interface is implemented on top of the same
+// concrete classes and stays available through shared() / native().
+template <class Backend>
+class basic_window {
+public:
+    using backend_type = Backend;
+    using native_type = typename Backend::window_type;
+
+    basic_window() = default;
+    explicit basic_window(std::shared_ptr<native_type> impl) : m_impl(std::move(impl)) {}
+
+    explicit operator bool() const { return static_cast<bool>(m_impl); }
+    native_type &native() const { return *m_impl; }
+    std::shared_ptr<Window> shared() const { return m_impl; }
+
+    void setTitle(std::string_view title) { m_impl->native_type::setTitle(title); }
+    void setAppId(std::string_view appId) { m_impl->native_type::setAppId(appId); }
+    std::string_view getTitle() const { return m_impl->native_type::getTitle(); }
+    std::string_view getAppId() const { return m_impl->native_type::getAppId(); }
+    std::string_view getInitialTitle() const { return m_impl->native_type::getInitialTitle(); }
+    std::string_view getInitialAppId() const { return m_impl->native_type::getInitialAppId(); }
+    void show() { m_impl->native_type::show(); }
+    bool shouldClose() const { return m_impl->native_type::shouldClose(); }
+    int getWidth() const { return m_impl->native_type::getWidth(); }
+    int getHeight() const { return m_impl->native_type::getHeight(); }
+    void setCursor(CursorShape shape) { m_impl->native_type::setCursor(shape); }
+    std::shared_ptr<Layer> createLayer(int x, int y, int width, int height)
+    {
+        return m_impl->native_type::createLayer(x, y, width, height);
+    }
+
+private:
+    std::shared_ptr<native_type> m_impl{};
+};
+
+template <class Backend>
+class basic_window_manager {
+public:
+    using backend_type = Backend;
+    using native_type = typename Backend::manager_type;
+    using window_type = basic_window<Backend>;
+
+    explicit basic_window_manager(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : m_impl(Backend::create(resource)) {}
+    explicit basic_window_manager(std::unique_ptr<native_type> impl) : m_impl(std::move(impl)) {}
+
+    explicit operator bool() const { return static_cast<bool>(m_impl); }
+    native_type &native() const { return *m_impl; }
+
+    window_type createWindow(int width, int height, std::string_view title)
+    {
+        return window_type(m_impl->native_type::createNativeWindow(width, height, title));
+    }
+
+    void prewarmWindows(size_t count, int width, int height) { m_impl->native_type::prewarmWindows(count, width, height); }
+
+    // Handler receives (Backend::window_type&, WmEvent) and optionally
+    // (Backend::window_type&, const MouseEvent&). It is a template parameter,
+    // so event delivery inlines into the loop instead of going through
+    // std::function. Callbacks set with setEventCallback() are not invoked.
+    template <class Handler>
+    void pollEvents(Handler &&handler)
+    {
+        m_impl->native_type::pumpEvents(false);
+        m_impl->dispatchQueued(std::forward<Handler>(handler));
+    }
+
+    template <class Handler>
+    void waitEvents(Handler &&handler)
+    {
+        m_impl->native_type::pumpEvents(true);
+        m_impl->dispatchQueued(std::forward<Handler>(handler));
+    }
+
+    template <class Handler>
+    int run(Handler &&handler)
+    {
+        while (!m_impl->native_type::shouldQuit() && m_impl->native_type::pumpEvents(true)) {
+            m_impl->dispatchQueued(handler);
+        }
+        return 0;
+    }
+
+    void requestQuit() { m_impl->native_type::requestQuit(); }
+    void beginBatch(bool atomic = false) { m_impl->native_type::beginBatch(atomic); }
+    void endBatch() { m_impl->native_type::endBatch(); }
+    std::span<const char *const> getVulkanInstanceExtensions() const { return m_impl->native_type::getVulkanInstanceExtensions(); }
+    std::pmr::memory_resource *getMemoryResource() const { return m_impl->native_type::getMemoryResource(); }
+    void setErrorCallback(const ErrorCallback &cb) { m_impl->native_type::setErrorCallback(cb); }
+
+    VkResult createVulkanWindowSurface(
+        VkInstance instance,
+        window_type &window,
+        const VkAllocationCallbacks *allocator,
+        VkSurfaceKHR *surface
+    ) const
+    {
+        return m_impl->native_type::createVulkanSurface(instance, window.native(), allocator, surface);
+    }
+
+private:
+    std::unique_ptr<native_type> m_impl{};
+};
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#ifdef WM_USE_VULKAN
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "window_manager/basic_window_manager.hpp"
+#include "window_manager/window_manager.hpp"
+
+namespace wm {
+
+// Function pointers resolved once per VkInstance/VkDevice pair. Load one
+// and share it between every VulkanWindowSurface of that device so the
+// per-frame path never touches vkGet*ProcAddr.
+struct VulkanDispatch {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+
+    PFN_vkDestroySurfaceKHR destroySurface = nullptr;
+    PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR getSurfaceCapabilities = nullptr;
+    PFN_vkGetPhysicalDeviceSurfaceFormatsKHR getSurfaceFormats = nullptr;
+    PFN_vkGetPhysicalDeviceSurfacePresentModesKHR getSurfacePresentModes = nullptr;
+
+    PFN_vkCreateSwapchainKHR createSwapchain = nullptr;
+    PFN_vkDestroySwapchainKHR destroySwapchain = nullptr;
+    PFN_vkGetSwapchainImagesKHR getSwapchainImages = nullptr;
+    PFN_vkAcquireNextImageKHR acquireNextImage = nullptr;
+    PFN_vkQueuePresentKHR queuePresent = nullptr;
+    PFN_vkDeviceWaitIdle deviceWaitIdle = nullptr;
+
+    bool load(VkInstance inst, VkDevice dev);
+};
+
+enum class PresentModePreference : int {
+    // MAILBOX, then FIFO_RELAXED, then FIFO.
+    LowLatency = 0,
+    // FIFO_RELAXED, then FIFO.
+    Relaxed,
+    // FIFO only; always supported.
+    Vsync,
+    // IMMEDIATE, then MAILBOX, then FIFO.
+    Immediate,
+};
+
+struct VulkanSwapchainConfig {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkFormat preferredFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    VkColorSpaceKHR preferredColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    VkImageUsageFlags imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    PresentModePreference presentMode = PresentModePreference::LowLatency;
+    uint32_t minImageCount = 3;
+};
+
+// Owns a VkSurfaceKHR for a window plus its swapchain. The swapchain is
+// recreated lazily inside acquire() when the window extent changed, the
+// previous acquire/present reported OUT_OF_DATE/SUBOPTIMAL or invalidate()
+// was called. Nothing is recreated while suspended or while the window has
+// a zero extent; acquire() returns VK_NOT_READY instead.
+//
+// Replaced swapchains are not destroyed on the spot: they are retired and
+// released once as many presents as they had images have gone by, which
+// assumes the caller keeps no more frames in flight than that. Only if
+// resizes outpace that window does the helper fall back to vkDeviceWaitIdle.
+class VulkanWindowSurface {
+public:
+    VulkanWindowSurface() = default;
+    ~VulkanWindowSurface();
+    VulkanWindowSurface(const VulkanWindowSurface &) = delete;
+    VulkanWindowSurface &operator=(const VulkanWindowSurface &) = delete;
+
+    VkResult init(
+        const WindowManager &mgr,
+        Window &window,
+        const VulkanDispatch &dispatch,
+        const VulkanSwapchainConfig &config,
+        const VkAllocationCallbacks *allocator = nullptr
+    );
+    // Same for the statically dispatched front end: the surface is created
+    // through basic_window_manager without a virtual call or dynamic_cast.
+    template <class Backend>
+    VkResult init(
+        const basic_window_manager<Backend> &mgr,
+        basic_window<Backend> &window,
+        const VulkanDispatch &dispatch,
+        const VulkanSwapchainConfig &config,
+        const VkAllocationCallbacks *allocator = nullptr
+    )
+    {
+        destroy();
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+        const VkResult res = mgr.createVulkanWindowSurface(dispatch.instance, window, allocator, &surface);
+        if (res != VK_SUCCESS) return res;
+        using native_type = typename basic_window<Backend>::native_type;
+        const auto extent = [](const void *ctx) {
+            const auto &native = *static_cast<const native_type *>(ctx);
+            return VkExtent2D{
+                static_cast<uint32_t>(std::max(native.native_type::getWidth(), 0)),
+                static_cast<uint32_t>(std::max(native.native_type::getHeight(), 0)),
+            };
+        };
+        adopt(surface, extent, &window.native(), dispatch, config, allocator);
+        return VK_SUCCESS;
+    }
+    void destroy();
+
+    // SUBOPTIMAL is reported as VK_SUCCESS since the image is still usable;
+    // the swapchain is rebuilt before the next acquire either way.
+    VkResult acquire(uint64_t timeout, VkSemaphore signal, VkFence fence, uint32_t *imageIndex);
+    // Returns the queue's result as is. OUT_OF_DATE and SUBOPTIMAL need no
+    // handling beyond skipping the frame: the next acquire() recreates.
+    VkResult present(VkQueue queue, uint32_t imageIndex, std::span<const VkSemaphore> waits);
+
+    void invalidate() { m_dirty = true; }
+    // Releases the swapchain (e.g. while minimised or backgrounded); the
+    // next acquire() after resume() rebuilds it.
+    void suspend();
+    void resume() { m_suspended = false; m_dirty = true; }
+
+    VkSurfaceKHR surface() const { return m_surface; }
+    VkSwapchainKHR swapchain() const { return m_swapchain; }
+    VkFormat format() const { return m_format.format; }
+    VkExtent2D extent() const { return m_extent; }
+    VkPresentModeKHR presentMode() const { return m_presentMode; }
+    std::span<const VkImage> images() const { return m_images; }
+    // Bumped on every recreation so callers know to rebuild image views.
+    uint64_t generation() const { return m_generation; }
+
+private:
+    // Current window size; a plain function pointer so the per-frame size
+    // check does not go through the Window vtable on the static front end.
+    using ExtentFn = VkExtent2D (*)(const void *ctx);
+
+    struct Retired {
+        VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+        uint32_t presentsLeft = 0;
+    };
+
+    // Takes ownership of a freshly created surface and queries what it supports.
+    void adopt(
+        VkSurfaceKHR surface,
+        ExtentFn extentFn,
+        const void *extentCtx,
+        const VulkanDispatch &dispatch,
+        const VulkanSwapchainConfig &config,
+        const VkAllocationCallbacks *allocator
+    );
+    VkResult recreate();
+    void retire(VkSwapchainKHR swapchain, uint32_t imageCount);
+    void release_retired(bool all);
+    VkPresentModeKHR choose_present_mode() const;
+    VkSurfaceFormatKHR choose_format() const;
+
+    const VulkanDispatch *m_dispatch = nullptr;
+    const VkAllocationCallbacks *m_allocator = nullptr;
+    ExtentFn m_extentFn = nullptr;
+    const void *m_extentCtx = nullptr;
+    VulkanSwapchainConfig m_config{};
+    VkSurfaceKHR m_surface = VK_NULL_HANDLE;
+    VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
+    VkSurfaceFormatKHR m_format{};
+    VkExtent2D m_extent{};
+    // Window size the swapchain was built for, before clamping to the
+    // surface limits; acquire() compares against this, not m_extent.
+    VkExtent2D m_requested{};
+    VkPresentModeKHR m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    std::array<Retired, 4> m_retired{};
+    std::vector<VkImage> m_images;
+    std::vector<VkSurfaceFormatKHR> m_formats;
+    std::vector<VkPresentModeKHR> m_presentModes;
+    uint64_t m_generation = 0;
+    bool m_dirty = true;
+    bool m_suspended = false;
+};
+
+}
+
+#endif
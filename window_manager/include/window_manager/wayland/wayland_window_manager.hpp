@@ -0,0 +1,478 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <sys/mman.h>
+#include <poll.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "window_manager/window_manager.hpp"
+
+struct xdg_wm_base;
+struct xdg_surface;
+struct xdg_toplevel;
+struct wp_cursor_shape_manager_v1;
+struct zwp_relative_pointer_manager_v1;
+struct zwp_relative_pointer_v1;
+struct zwp_pointer_constraints_v1;
+struct zwp_locked_pointer_v1;
+struct zwp_confined_pointer_v1;
+struct zxdg_decoration_manager_v1;
+struct zxdg_toplevel_decoration_v1;
+
+namespace wm::capture_impl {
+class FrameCapture;
+}
+
+namespace wm::wayland_impl {
+
+struct MmapDeleter {
+    size_t m_size = 0;
+    void operator()(void *ptr) const {
+        if (ptr && ptr != MAP_FAILED) {
+            munmap(ptr, m_size);
+        }
+    }
+};
+using MmapUniquePtr = std::unique_ptr<void, MmapDeleter>;
+
+struct ShmBuffer {
+    wl_buffer *buffer = nullptr;
+    MmapUniquePtr data{};
+    int fd = -1;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    size_t size = 0;
+};
+
+int create_shm_file(size_t size);
+bool create_shm_buffer(wl_shm *shm, int width, int height, uint32_t format, ShmBuffer &out);
+void release_shm_buffer(ShmBuffer &buf);
+
+class WaylandWindow;
+class WaylandLayer;
+class WaylandDataDevice;
+class WaylandCursor;
+class WaylandTouch;
+class WaylandDecoration;
+
+// Event recorded while dispatching Wayland callbacks. Delivery happens after
+// the dispatch returns so that both the std::function callbacks and the
+// statically typed handlers of basic_window_manager share one code path.
+struct PendingEvent {
+    WaylandWindow *window = nullptr;
+    std::variant<wm::WmEvent, wm::MouseEvent, wm::DropEvent, wm::TouchFrame, wm::RelativeMotion> payload{};
+};
+
+class WaylandWindowManager final : public wm::WindowManager {
+public:
+    explicit WaylandWindowManager(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    ~WaylandWindowManager() override;
+
+    std::shared_ptr<wm::Window> createWindow(int width, int height, std::string_view title) override;
+    void prewarmWindows(size_t count, int width, int height) override;
+    int run() override;
+    void requestQuit() override;
+    void pollEvents() override;
+    void waitEvents() override;
+    void beginBatch(bool atomic = false) override;
+    void endBatch() override;
+
+    void setEventCallback(const wm::EventCallback &cb) override { m_eventCb = cb; }
+    void setErrorCallback(const wm::ErrorCallback &cb) override { m_errorCb = cb; }
+    std::span<const char *const> getVulkanInstanceExtensions() const override;
+    std::pmr::memory_resource *getMemoryResource() const override { return m_resource; }
+
+    std::span<const std::pmr::string> getClipboardMimeTypes() const override;
+    bool receiveClipboard(std::string_view mimeType, const wm::DataChunkCallback &cb, int sinkFd = -1) override;
+    bool setClipboard(std::span<const std::string_view> mimeTypes, const wm::DataProvider &provider) override;
+    void clearClipboard() override;
+    std::span<const std::pmr::string> getDropMimeTypes() const override;
+    void acceptDrop(std::string_view mimeType) override;
+    bool receiveDrop(std::string_view mimeType, const wm::DataChunkCallback &cb, int sinkFd = -1) override;
+    bool startCapture(const wm::CaptureConfig &config) override;
+    void stopCapture() override;
+    wm::CaptureStats getCaptureStats() const override;
+    VkResult createVulkanWindowSurface(
+        VkInstance instance,
+        wm::Window &window,
+        const VkAllocationCallbacks *allocator,
+        VkSurfaceKHR *surface
+    ) const override;
+
+    // Non-virtual core used by basic_window_manager<wayland_backend>; the
+    // overrides above forward here.
+    std::shared_ptr<WaylandWindow> createNativeWindow(int width, int height, std::string_view title);
+    VkResult createVulkanSurface(
+        VkInstance instance,
+        WaylandWindow &window,
+        const VkAllocationCallbacks *allocator,
+        VkSurfaceKHR *surface
+    ) const;
+
+    // Maps pending windows, flushes and reads from the display. Events are
+    // queued, not delivered; call dispatchQueued() afterwards. A blocking
+    // pump only sleeps when nothing is queued yet. Inside a batch only a
+    // pump that sleeps flushes.
+    bool pumpEvents(bool block);
+    bool shouldQuit() const { return m_should_quit; }
+
+    // Handler is called as handler(WaylandWindow&, wm::WmEvent) and, for
+    // each overload it provides, with const wm::MouseEvent&,
+    // const wm::DropEvent&, const wm::TouchFrame& or const wm::RelativeMotion&
+    // in place of the WmEvent.
+    template <class Handler>
+    void dispatchQueued(Handler &&handler);
+
+    void queueEvent(WaylandWindow &window, wm::WmEvent event);
+    void queueMouseEvent(WaylandWindow &window, const wm::MouseEvent &event);
+    void queueDropEvent(WaylandWindow &window, const wm::DropEvent &event);
+    void queueTouchFrame(WaylandWindow &window, const wm::TouchFrame &frame);
+    // Latest input serial, needed for requests like set_selection.
+    void noteInputSerial(uint32_t serial) { m_inputSerial = serial; }
+    void forgetWindow(const WaylandWindow *window);
+    // Re-applies the cursor if the pointer is currently over window.
+    void updateCursor(const WaylandWindow &window);
+    // Commits now, or at endBatch() while a batch is open. syncParent is
+    // set for a synchronized subsurface: its state only shows once that
+    // surface commits too.
+    void requestCommit(wl_surface *surface, wl_surface *syncParent = nullptr);
+    void requestCommit(WaylandLayer &layer);
+    // Drops deferred commits of a surface that is going away.
+    void forgetSurface(const wl_surface *surface);
+
+    wl_display *display() const { return m_display; }
+    wl_compositor *compositor() const { return m_compositor; }
+    wl_shm *shm() const { return m_shm; }
+    wl_subcompositor *subcompositor() const { return m_subcompositor; }
+    uint32_t compositorVersion() const { return m_compositorVersion; }
+    xdg_wm_base *wm_base() const { return m_xdg_wm_base; }
+    wl_seat *seat() const { return m_seat; }
+    wl_pointer *pointer() const { return m_pointer; }
+    zwp_pointer_constraints_v1 *pointerConstraints() const { return m_pointerConstraints; }
+    zxdg_decoration_manager_v1 *decorationManager() const { return m_decorationManager; }
+    // Null unless a capture is running.
+    capture_impl::FrameCapture *capture() const { return m_captureRunning ? m_capture.get() : nullptr; }
+
+    static std::unique_ptr<wm::WindowManager> create(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    static std::unique_ptr<WaylandWindowManager> createNative(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    static void handle_global(void *data, wl_registry *registry, uint32_t name, const char *interface, uint32_t version);
+    static void handle_global_remove(void *data, wl_registry *registry, uint32_t name);
+    static void handle_wm_base_ping(void *data, xdg_wm_base *wm, uint32_t serial);
+    static void handle_seat_capabilities(void *data, wl_seat *seat, uint32_t caps);
+    static void handle_seat_name(void *data, wl_seat *seat, const char *name);
+    static void handle_pointer_enter(void *data, wl_pointer *pointer, uint32_t serial, wl_surface *surface, wl_fixed_t x, wl_fixed_t y);
+    static void handle_pointer_leave(void *data, wl_pointer *pointer, uint32_t serial, wl_surface *surface);
+    static void handle_pointer_motion(void *data, wl_pointer *pointer, uint32_t time, wl_fixed_t x, wl_fixed_t y);
+    static void handle_pointer_button(void *data, wl_pointer *pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state);
+    static void handle_pointer_axis(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis, wl_fixed_t value);
+    static void handle_pointer_frame(void *data, wl_pointer *pointer);
+    static void handle_pointer_axis_source(void *data, wl_pointer *pointer, uint32_t axis_source);
+    static void handle_pointer_axis_stop(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis);
+    static void handle_pointer_axis_discrete(void *data, wl_pointer *pointer, uint32_t axis, int32_t discrete);
+    static void handle_pointer_axis_value120(void *data, wl_pointer *pointer, uint32_t axis, int32_t value120);
+    static void handle_relative_motion(void *data, zwp_relative_pointer_v1 *pointer, uint32_t utime_hi, uint32_t utime_lo, wl_fixed_t dx, wl_fixed_t dy, wl_fixed_t dx_unaccel, wl_fixed_t dy_unaccel);
+
+private:
+    // Returns a window record to the pool, or destroys it when the pool is
+    // full. Used as the deleter of every window handed out. A window the
+    // manager detached on its way out is only freed: mgr is gone by then.
+    struct WindowRecycler {
+        WaylandWindowManager *mgr = nullptr;
+        std::pmr::memory_resource *resource = nullptr;
+        void operator()(WaylandWindow *window) const;
+    };
+
+    void map_windows();
+    WaylandWindow *new_window(int width, int height, std::string_view title);
+    void destroy_window(WaylandWindow *window);
+    void recycle(WaylandWindow *window);
+    void dispatch_callbacks();
+    void bind_data_device();
+    void setup_pointer(bool available);
+    void setup_touch(bool available);
+    void setup_relative_pointer();
+    void apply_constraints();
+    // Queues the relative motion summed for the window it was seen on.
+    void flush_relative_motion();
+    // Frees per-dispatch storage once nothing queued refers to it.
+    void release_event_storage();
+
+    // A commit held back by an open batch.
+    struct BatchCommit {
+        wl_surface *surface = nullptr;
+        wl_surface *parent = nullptr;
+        WaylandLayer *layer = nullptr;
+    };
+
+    std::pmr::memory_resource *m_resource = nullptr;
+    wl_display *m_display = nullptr;
+    wl_registry *m_registry = nullptr;
+    wl_compositor *m_compositor = nullptr;
+    uint32_t m_compositorVersion = 0;
+    wl_shm *m_shm = nullptr;
+    wl_subcompositor *m_subcompositor = nullptr;
+    xdg_wm_base *m_xdg_wm_base = nullptr;
+    wl_seat *m_seat = nullptr;
+    std::unique_ptr<WaylandDataDevice> m_dataDevice;
+    wp_cursor_shape_manager_v1 *m_cursorShapeManager = nullptr;
+    // One pointer for the seat; focus comes from the surface user data.
+    wl_pointer *m_pointer = nullptr;
+    std::unique_ptr<WaylandCursor> m_cursor;
+    WaylandWindow *m_pointerFocus = nullptr;
+    // Surface under the pointer (the window's own or its title bar) and the
+    // position on it.
+    wl_surface *m_pointerSurface = nullptr;
+    double m_surfaceX = 0.0;
+    double m_surfaceY = 0.0;
+    uint32_t m_pointerSerial = 0;
+    std::unique_ptr<WaylandTouch> m_touch;
+    zwp_relative_pointer_manager_v1 *m_relativePointerManager = nullptr;
+    zwp_relative_pointer_v1 *m_relativePointer = nullptr;
+    zwp_pointer_constraints_v1 *m_pointerConstraints = nullptr;
+    zxdg_decoration_manager_v1 *m_decorationManager = nullptr;
+    WaylandWindow *m_relativeWindow = nullptr;
+    wm::RelativeMotion m_relative{};
+    std::unique_ptr<capture_impl::FrameCapture> m_capture;
+    bool m_captureRunning = false;
+    uint32_t m_inputSerial = 0;
+    bool m_should_quit = false;
+    bool m_inDispatch = false;
+
+    std::pmr::vector<std::weak_ptr<WaylandWindow>> m_windows;
+    // Parked, unmapped records ready to be handed out again.
+    std::pmr::vector<WaylandWindow *> m_pool;
+    size_t m_poolLimit = 4;
+    std::pmr::vector<PendingEvent> m_pending;
+    std::pmr::vector<PendingEvent> m_dispatching;
+    std::pmr::vector<pollfd> m_pollFds;
+    std::pmr::vector<BatchCommit> m_batchCommits;
+    unsigned m_batchDepth = 0;
+    bool m_batchAtomic = false;
+
+    wm::EventCallback m_eventCb{};
+    wm::ErrorCallback m_errorCb{};
+
+#ifdef WM_USE_VULKAN
+    // vkCreateWaylandSurfaceKHR resolved for the last instance seen.
+    mutable VkInstance m_vkInstance = VK_NULL_HANDLE;
+    mutable PFN_vkVoidFunction m_vkCreateWaylandSurface = nullptr;
+#endif
+};
+
+class WaylandWindow final : public wm::Window, public std::enable_shared_from_this<WaylandWindow> {
+public:
+    WaylandWindow(WaylandWindowManager &mgr, int width, int height, std::string_view title);
+    ~WaylandWindow() override;
+
+    void setTitle(std::string_view title) override;
+    void setAppId(std::string_view appId) override;
+    std::string_view getTitle() const override { return m_title; }
+    std::string_view getAppId() const override { return m_appId; }
+    std::string_view getInitialTitle() const override { return m_initialTitle; }
+    std::string_view getInitialAppId() const override { return m_initialAppId; }
+    void show() override;
+    bool shouldClose() const override { return m_shouldClose; }
+    int getWidth() const override { return m_width; }
+    int getHeight() const override { return m_height; }
+    void setEventCallback(const wm::EventCallback &cb) override { m_windowEventCb = cb; }
+    void setMouseCallback(const wm::MouseCallback &cb) override { m_mouseCb = cb; }
+    void setDropCallback(const wm::DropCallback &cb) override { m_dropCb = cb; }
+    void setTouchCallback(const wm::TouchCallback &cb) override { m_touchCb = cb; }
+    void setRelativeMotionCallback(const wm::RelativeMotionCallback &cb) override { m_relativeCb = cb; }
+    bool setPointerConstraint(wm::PointerConstraint constraint) override;
+    bool isPointerConstrained() const override { return m_constraintActive; }
+    void setCursor(wm::CursorShape shape) override;
+    std::shared_ptr<wm::Layer> createLayer(int x, int y, int width, int height) override;
+
+    wl_surface *surface() const { return m_surface; }
+    wm::CursorShape cursor() const { return m_cursor; }
+
+    void mapIfNeeded();
+
+    static void handle_xdg_surface_configure(void *data, xdg_surface *xdg_surface_obj, uint32_t serial);
+    static void handle_toplevel_configure(void *data, xdg_toplevel *toplevel, int32_t width, int32_t height, wl_array *states);
+    static void handle_toplevel_close(void *data, xdg_toplevel *toplevel);
+    static void handle_decoration_configure(void *data, zxdg_toplevel_decoration_v1 *decoration, uint32_t mode);
+    static void handle_locked(void *data, zwp_locked_pointer_v1 *locked);
+    static void handle_unlocked(void *data, zwp_locked_pointer_v1 *locked);
+    static void handle_confined(void *data, zwp_confined_pointer_v1 *confined);
+    static void handle_unconfined(void *data, zwp_confined_pointer_v1 *confined);
+
+private:
+    friend class WaylandWindowManager;
+    friend class WaylandLayer;
+    friend class WaylandTouch;
+    friend class WaylandDataDevice;
+
+    // Title bars come from the manager's resource like the window records.
+    // No member initializer: it would keep the type from counting as
+    // default-constructible inside the still-incomplete WaylandWindow.
+    struct DecorationDeleter {
+        std::pmr::memory_resource *resource;
+        void operator()(WaylandDecoration *decoration) const;
+    };
+
+    bool create_buffer(int width, int height, uint32_t xrgb);
+    // Records the whole window buffer if a capture is running.
+    void capture_buffer();
+    void set_client_decorations(bool enable);
+    // Window geometry and title bar. Both only apply with a commit of the
+    // window, so a change marks it for one after the configure is acked.
+    void update_decorations();
+    bool on_decoration(const wl_surface *surface) const;
+    // Press on the title bar starts an interactive move; on the close
+    // button it requests close. Never reaches the mouse callback.
+    void decoration_button(double x, double y, uint32_t serial, bool pressed);
+    // Drops per-use state and unmaps; the role objects, buffer and title bar
+    // are kept and the initial commit is redone so a configure comes back.
+    void park();
+    // Destroys every protocol object while the manager still exists. Runs
+    // from the destructor, or from the manager's when it goes first; the
+    // record is inert afterwards and only good for being destroyed.
+    void detach();
+    void unpark(int width, int height, std::string_view title);
+    // Creates the lock/confine object for m_constraint if the seat allows it.
+    void apply_constraint();
+    void release_constraint();
+
+    WaylandWindowManager &m_mgr;
+    wl_surface *m_surface = nullptr;
+    xdg_surface *m_xdg_surface = nullptr;
+    xdg_toplevel *m_toplevel = nullptr;
+    zxdg_toplevel_decoration_v1 *m_toplevelDecoration = nullptr;
+    std::unique_ptr<WaylandDecoration, DecorationDeleter> m_decoration;
+    // Last xdg_surface.set_window_geometry sent: y offset, width, height.
+    std::array<int32_t, 3> m_geometry{};
+    bool m_decorationsChanged = false;
+    zwp_locked_pointer_v1 *m_lockedPointer = nullptr;
+    zwp_confined_pointer_v1 *m_confinedPointer = nullptr;
+    wm::PointerConstraint m_constraint = wm::PointerConstraint::None;
+    bool m_constraintActive = false;
+    ShmBuffer m_buf{};
+    bool m_configured = false;
+    bool m_initialCommitted = false;
+    bool m_mapped = false;
+    bool m_shouldClose = false;
+    bool m_hasFocus = false;
+    // Sitting in the manager's pool; its events are not delivered.
+    bool m_pooled = false;
+    bool m_detached = false;
+    // A Vulkan surface was created on it; the library stops attaching SHM.
+    bool m_vulkanOwned = false;
+    // Resized by a configure; attached and committed once that is acked.
+    bool m_bufferChanged = false;
+    int m_width = 0;
+    int m_height = 0;
+    std::pmr::string m_title;
+    std::pmr::string m_appId;
+    std::pmr::string m_initialTitle;
+    std::pmr::string m_initialAppId;
+    double m_pointerX = 0.0;
+    double m_pointerY = 0.0;
+    wm::CursorShape m_cursor = wm::CursorShape::Default;
+    wm::EventCallback m_windowEventCb{};
+    wm::MouseCallback m_mouseCb{};
+    wm::DropCallback m_dropCb{};
+    wm::TouchCallback m_touchCb{};
+    wm::RelativeMotionCallback m_relativeCb{};
+};
+
+class WaylandLayer final : public wm::Layer {
+public:
+    WaylandLayer(std::shared_ptr<WaylandWindow> parent, int x, int y, int width, int height);
+    ~WaylandLayer() override;
+
+    void setPosition(int x, int y) override;
+    void setDesync(bool desync) override;
+    void setVisible(bool visible) override;
+    int getWidth() const override { return m_buf.width; }
+    int getHeight() const override { return m_buf.height; }
+    int getStride() const override { return m_buf.stride / 4; }
+    std::span<uint32_t> pixels() override;
+    bool isBusy() const override { return m_busy; }
+    void damage(int x, int y, int width, int height) override;
+    void commit() override;
+
+    bool valid() const { return m_subsurface && m_buf.buffer; }
+
+    static void handle_buffer_release(void *data, wl_buffer *buffer);
+
+private:
+    friend class WaylandWindowManager;
+
+    struct Rect {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+    static constexpr size_t MAX_DAMAGE_RECTS = 8;
+
+    // Subsurface placement and synchronized content apply on a commit of
+    // the parent; the window has no commit of its own to wait for.
+    void commit_parent();
+
+    // Keeps the parent surface alive for as long as the subsurface exists.
+    std::shared_ptr<WaylandWindow> m_parent;
+    wl_surface *m_surface = nullptr;
+    wl_subsurface *m_subsurface = nullptr;
+    ShmBuffer m_buf{};
+    int m_x = 0;
+    int m_y = 0;
+    std::array<Rect, MAX_DAMAGE_RECTS> m_damage{};
+    size_t m_damageCount = 0;
+    bool m_fullDamage = true;
+    bool m_visible = true;
+    bool m_desync = true;
+    bool m_attached = false;
+    bool m_busy = false;
+};
+
+template <class Handler>
+void WaylandWindowManager::dispatchQueued(Handler &&handler)
+{
+    // Swap out so handlers may create or destroy windows without invalidating
+    // the range we iterate; forgetWindow() nulls entries here. Nested calls
+    // from inside a handler leave their events for the next dispatch.
+    if (m_inDispatch) return;
+    // Unwinds on exit, handler exceptions included; otherwise a throwing
+    // handler would leave every later dispatch returning early. Events
+    // after the one that threw are dropped.
+    struct DispatchScope {
+        WaylandWindowManager &mgr;
+        ~DispatchScope()
+        {
+            mgr.m_dispatching.clear();
+            mgr.m_inDispatch = false;
+            if (mgr.m_pending.empty()) mgr.release_event_storage();
+        }
+    };
+    m_inDispatch = true;
+    const DispatchScope scope{*this};
+    m_dispatching.clear();
+    m_dispatching.swap(m_pending);
+    for (size_t i = 0; i < m_dispatching.size(); ++i) {
+        const PendingEvent ev = m_dispatching[i];
+        if (!ev.window) continue;
+        std::visit([&](const auto &payload) {
+            if constexpr (std::is_invocable_v<Handler &, WaylandWindow &, decltype(payload)>) {
+                handler(*ev.window, payload);
+            }
+        }, ev.payload);
+    }
+}
+
+}
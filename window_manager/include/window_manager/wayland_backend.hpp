@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+
+#include "window_manager/basic_window_manager.hpp"
+#include "window_manager/wayland/wayland_window_manager.hpp"
+
+namespace wm {
+
+struct wayland_backend {
+    using manager_type = wayland_impl::WaylandWindowManager;
+    using window_type = wayland_impl::WaylandWindow;
+
+    static std::unique_ptr<manager_type> create(std::pmr::memory_resource *resource)
+    {
+        return manager_type::createNative(resource);
+    }
+};
+
+using wayland_window_manager = basic_window_manager<wayland_backend>;
+using wayland_window = basic_window<wayland_backend>;
+
+}
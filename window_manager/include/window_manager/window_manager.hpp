@@ -1,8 +1,14 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <string>
+#include <string_view>
 #include <functional>
+#include <vector>
 
 #ifdef WM_USE_VULKAN
 #include <vulkan/vulkan.h>
@@ -32,6 +38,10 @@ enum class WmEvent : int {
     WindowFocusGained,
     WindowFocusLost,
     Ping,
+    // A lock or confine requested with Window::setPointerConstraint took
+    // effect, or was lifted by the compositor (e.g. on focus loss).
+    PointerConstraintActivated,
+    PointerConstraintDeactivated,
 };
 
 class Window;
@@ -63,34 +73,253 @@ struct MouseEvent {
 
 using MouseCallback = std::function<void(const MouseEvent&, Window&)>;
 
+enum class TouchState : uint8_t {
+    Down = 0,
+    Motion = 1,
+    Up = 2,
+    Cancel = 3,
+};
+
+// Every contact that changed on this window during one wl_touch.frame, as
+// parallel arrays indexed by contact. Repeated motion of one contact within
+// a frame is folded into its latest position. The spans stay valid only for
+// the duration of the callback.
+struct TouchFrame {
+    std::span<const int32_t> ids{};
+    std::span<const double> x{};
+    std::span<const double> y{};
+    std::span<const TouchState> states{};
+    // Per-contact event time in milliseconds.
+    std::span<const uint32_t> times{};
+
+    size_t size() const { return ids.size(); }
+};
+
+using TouchCallback = std::function<void(const TouchFrame&, Window&)>;
+
+// Raw pointer motion summed over every relative-pointer event since the last
+// delivery. Sums are kept in the protocol's 1/256 px fixed-point units so no
+// precision is lost however many events are folded together.
+struct RelativeMotion {
+    static constexpr double UNITS_PER_PIXEL = 256.0;
+
+    int64_t dx = 0;
+    int64_t dy = 0;
+    // Without pointer acceleration applied.
+    int64_t dxUnaccel = 0;
+    int64_t dyUnaccel = 0;
+    // Timestamp of the latest folded event, in microseconds.
+    uint64_t timeUs = 0;
+    uint32_t eventCount = 0;
+
+    double unaccelX() const { return static_cast<double>(dxUnaccel) / UNITS_PER_PIXEL; }
+    double unaccelY() const { return static_cast<double>(dyUnaccel) / UNITS_PER_PIXEL; }
+};
+
+using RelativeMotionCallback = std::function<void(const RelativeMotion&, Window&)>;
+
+enum class PointerConstraint : int {
+    None = 0,
+    // Pointer stays where it is; only relative motion is reported.
+    Lock = 1,
+    // Pointer moves but cannot leave the window.
+    Confine = 2,
+};
+
+enum class CursorShape : int {
+    Default = 0,
+    Text,
+    Pointer,
+    Crosshair,
+    Move,
+    Wait,
+    Progress,
+    NotAllowed,
+    Grab,
+    Grabbing,
+    ResizeNS,
+    ResizeEW,
+    ResizeNWSE,
+    ResizeNESW,
+    Hidden,
+    Count,
+};
+
+enum class DropAction : int {
+    Enter = 0,
+    Motion = 1,
+    Leave = 2,
+    Drop = 3,
+};
+
+struct DropEvent {
+    DropAction action = DropAction::Enter;
+    double x = 0.0;
+    double y = 0.0;
+};
+
+using DropCallback = std::function<void(const DropEvent&, Window&)>;
+
+enum class TransferStatus : int {
+    Data = 0,
+    Done,
+    Failed,
+};
+
+// Incoming clipboard/drop data arrives in chunks from the event loop; the
+// span is only valid during the call. The last call carries Done or Failed.
+// Unlike window events these are not queued: they run directly inside
+// pollEvents/waitEvents/run while the pipe is serviced, before the queued
+// window events of the same pass are dispatched.
+using DataChunkCallback = std::function<void(std::span<const std::byte> chunk, TransferStatus status)>;
+
+// What to send for one requested mime type. Either an in-memory blob or a
+// file descriptor (streamed with sendfile; duplicated, caller keeps its own).
+struct DataPayload {
+    std::shared_ptr<const std::vector<std::byte>> bytes{};
+    int fd = -1;
+    size_t offset = 0;
+    // Bytes to send from fd; 0 means up to the end of the file.
+    size_t length = 0;
+};
+
+using DataProvider = std::function<DataPayload(std::string_view mimeType)>;
+
+enum class CaptureFormat : int {
+    // Damaged rows copied as-is.
+    Raw = 0,
+    // (count, pixel) uint32 pairs per damaged rect.
+    RunLength = 1,
+};
+
+// Opt-in recording of every buffer a window or layer commits. Damaged
+// regions are copied into a ring of slots allocated by startCapture() and
+// written to path by a background thread; when every slot is still waiting
+// for the writer the frame is dropped and counted instead of blocking.
+struct CaptureConfig {
+    std::string_view path{};
+    CaptureFormat format = CaptureFormat::Raw;
+    size_t slotCount = 8;
+    size_t slotBytes = 16 * 1024 * 1024;
+};
+
+struct CaptureStats {
+    uint64_t framesCaptured = 0;
+    uint64_t framesWritten = 0;
+    uint64_t framesDropped = 0;
+    uint64_t bytesWritten = 0;
+};
+
+// Independently updated region of a window (a wl_subsurface on Wayland) with
+// its own ARGB8888 buffer. Only layers that are committed send new content,
+// so static chrome is uploaded once while animated regions update alone.
+class Layer {
+public:
+    virtual ~Layer() = default;
+    // Position relative to the parent window. Applied with a commit of the
+    // window, which the layer requests itself.
+    virtual void setPosition(int x, int y) = 0;
+    // Desynchronized layers (the default) show a commit immediately;
+    // synchronized ones show together with a commit of the parent window.
+    virtual void setDesync(bool desync) = 0;
+    // Hiding detaches the buffer. Showing re-attaches the current pixels
+    // with full damage and commits the layer and its window, so no extra
+    // commit() is needed.
+    virtual void setVisible(bool visible) = 0;
+    virtual int getWidth() const = 0;
+    virtual int getHeight() const = 0;
+    // Row stride in pixels.
+    virtual int getStride() const = 0;
+    virtual std::span<uint32_t> pixels() = 0;
+    // True while the compositor may still read the buffer; writing to
+    // pixels() then can tear.
+    virtual bool isBusy() const = 0;
+    virtual void damage(int x, int y, int width, int height) = 0;
+    // Attaches the buffer with the damage accumulated since the last commit.
+    virtual void commit() = 0;
+};
+
 class Window {
 public:
     virtual ~Window() = default;
-    virtual void setTitle(const std::string &title) = 0;
-    virtual void setAppId(const std::string &appId) = 0;
-    virtual std::string getTitle() const = 0;
-    virtual std::string getAppId() const = 0;
-    virtual std::string getInitialTitle() const = 0;
-    virtual std::string getInitialAppId() const = 0;
+    virtual void setTitle(std::string_view title) = 0;
+    virtual void setAppId(std::string_view appId) = 0;
+    // Views stay valid until the next setTitle/setAppId or window destruction.
+    virtual std::string_view getTitle() const = 0;
+    virtual std::string_view getAppId() const = 0;
+    virtual std::string_view getInitialTitle() const = 0;
+    virtual std::string_view getInitialAppId() const = 0;
     virtual void show() = 0;
     virtual bool shouldClose() const = 0;
     virtual int getWidth() const = 0;
     virtual int getHeight() const = 0;
     virtual void setEventCallback(const EventCallback &cb) = 0;
     virtual void setMouseCallback(const MouseCallback &cb) = 0;
+    virtual void setDropCallback(const DropCallback &cb) = 0;
+    virtual void setTouchCallback(const TouchCallback &cb) = 0;
+    virtual void setRelativeMotionCallback(const RelativeMotionCallback &cb) = 0;
+    // Requests a lock or confine while this window has pointer focus; false
+    // if the compositor lacks pointer constraints.
+    virtual bool setPointerConstraint(PointerConstraint constraint) = 0;
+    virtual bool isPointerConstrained() const = 0;
+    // Shown while the pointer is over this window.
+    virtual void setCursor(CursorShape shape) = 0;
+    virtual std::shared_ptr<Layer> createLayer(int x, int y, int width, int height) = 0;
 };
 
 class WindowManager {
 public:
     virtual ~WindowManager() = default;
-    virtual std::shared_ptr<Window> createWindow(int width, int height, const std::string &title) = 0;
+    // Reuses a pooled window record when one is available; a pre-warmed one
+    // is already configured, so show() maps it without a round trip.
+    virtual std::shared_ptr<Window> createWindow(int width, int height, std::string_view title) = 0;
+    // Creates count unmapped windows of this size and waits once for all of
+    // them to be configured. Destroyed windows also return to the pool.
+    virtual void prewarmWindows(size_t count, int width, int height) = 0;
     virtual int run() = 0;
     virtual void requestQuit() = 0;
     virtual void pollEvents() = 0;
     virtual void waitEvents() = 0;
+    // Holds back window and layer commits until the matching endBatch(),
+    // which sends them all, layers before their windows, with one flush.
+    // Batches nest; only the outermost endBatch() sends. With atomic set,
+    // desynchronized layers are synchronized for the batch so each window's
+    // layers appear in the same frame as the window itself.
+    virtual void beginBatch(bool atomic = false) = 0;
+    virtual void endBatch() = 0;
     virtual void setEventCallback(const EventCallback &cb) = 0;
     virtual void setErrorCallback(const ErrorCallback &cb) = 0;
-    virtual std::vector<std::string> getVulkanInstanceExtensions() const = 0;
+    // Static storage; suitable for VkInstanceCreateInfo::ppEnabledExtensionNames.
+    virtual std::span<const char *const> getVulkanInstanceExtensions() const = 0;
+    // Resource used for window records, the window list, strings and event
+    // storage. Fixed at creation and must outlive the manager and every
+    // window and layer handle. Handles that outlive the manager are inert:
+    // destroying them is the only valid use.
+    virtual std::pmr::memory_resource *getMemoryResource() const = 0;
+
+    // Clipboard and drag-and-drop. Transfers run through non-blocking pipes
+    // serviced by pollEvents/waitEvents/run. With sinkFd >= 0 the data is
+    // spliced straight into that descriptor and the callback only reports
+    // the final status. The sink is set to O_NONBLOCK for the duration of the
+    // transfer, which also affects its duplicates, and restored before the
+    // final status is reported.
+    virtual std::span<const std::pmr::string> getClipboardMimeTypes() const = 0;
+    virtual bool receiveClipboard(std::string_view mimeType, const DataChunkCallback &cb, int sinkFd = -1) = 0;
+    virtual bool setClipboard(std::span<const std::string_view> mimeTypes, const DataProvider &provider) = 0;
+    virtual void clearClipboard() = 0;
+    virtual std::span<const std::pmr::string> getDropMimeTypes() const = 0;
+    // The first offered type is accepted on enter; call to pick another one
+    // (or an empty view to refuse the drop).
+    virtual void acceptDrop(std::string_view mimeType) = 0;
+    virtual bool receiveDrop(std::string_view mimeType, const DataChunkCallback &cb, int sinkFd = -1) = 0;
+
+    // Replaces any capture in progress; false if the file or the staging
+    // ring could not be set up.
+    virtual bool startCapture(const CaptureConfig &config) = 0;
+    // Waits for the writer to drain what was already captured.
+    virtual void stopCapture() = 0;
+    // Totals of the running capture, or of the last one once stopped.
+    virtual CaptureStats getCaptureStats() const = 0;
 
     virtual VkResult createVulkanWindowSurface(
         VkInstance instance,
@@ -98,8 +327,22 @@ public:
         const VkAllocationCallbacks *allocator,
         VkSurfaceKHR *surface
     ) const = 0;
-    static std::unique_ptr<WindowManager> createDefault();
-    static std::unique_ptr<WindowManager> createWayland();
+    static std::unique_ptr<WindowManager> createDefault(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    static std::unique_ptr<WindowManager> createWayland(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+};
+
+// Scoped beginBatch()/endBatch(), e.g. around one frame's updates. Works
+// with WindowManager and basic_window_manager alike.
+template <class Manager = WindowManager>
+class BatchGuard {
+public:
+    explicit BatchGuard(Manager &mgr, bool atomic = false) : m_mgr(mgr) { m_mgr.beginBatch(atomic); }
+    ~BatchGuard() { m_mgr.endBatch(); }
+    BatchGuard(const BatchGuard &) = delete;
+    BatchGuard &operator=(const BatchGuard &) = delete;
+
+private:
+    Manager &m_mgr;
 };
 
 }
@@ -0,0 +1,261 @@
+#include "frame_capture.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace wm::capture_impl {
+
+FrameCapture::FrameCapture(std::pmr::memory_resource *resource)
+    : m_staging(resource), m_slots(resource), m_encoded(resource)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+    stop();
+}
+
+bool FrameCapture::start(const wm::CaptureConfig &config)
+{
+    stop();
+    if (config.path.empty() || config.slotCount == 0 || config.slotBytes < sizeof(RecordHeader)) return false;
+
+    const std::string path(config.path);
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) return false;
+
+    m_format = config.format;
+    m_slotBytes = config.slotBytes;
+    m_staging.resize(config.slotCount * config.slotBytes);
+    m_slots.assign(config.slotCount, Slot{});
+    // Sized for the worst case, one (count, pixel) pair per pixel of a full
+    // slot. The writer thread only indexes into it: growing it there would
+    // allocate from the manager's resource, which is not thread-safe.
+    m_encoded.clear();
+    if (m_format == wm::CaptureFormat::RunLength) m_encoded.resize(2 * (m_slotBytes / sizeof(uint32_t)));
+
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+    m_stop.store(false, std::memory_order_relaxed);
+    m_failed.store(false, std::memory_order_relaxed);
+    m_captured.store(0, std::memory_order_relaxed);
+    m_written.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+    m_bytesWritten.store(0, std::memory_order_relaxed);
+
+    const FileHeader header{.format = static_cast<uint32_t>(m_format)};
+    if (!write_all(&header, sizeof(header))) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_writer = std::thread([this] { writer_loop(); });
+    return true;
+}
+
+void FrameCapture::stop()
+{
+    if (m_writer.joinable()) {
+        m_stop.store(true, std::memory_order_release);
+        m_signal.fetch_add(1, std::memory_order_release);
+        m_signal.notify_one();
+        m_writer.join();
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    // Statistics stay readable; the staging ring does not need to.
+    m_staging.clear();
+    m_staging.shrink_to_fit();
+    m_encoded.clear();
+    m_encoded.shrink_to_fit();
+}
+
+void FrameCapture::submit(const CaptureSurface &surface, const std::span<const CaptureRect> rects)
+{
+    if (m_fd < 0 || !surface.pixels || rects.empty()) return;
+    m_captured.fetch_add(1, std::memory_order_relaxed);
+
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    if (m_failed.load(std::memory_order_relaxed)
+        || head - m_tail.load(std::memory_order_acquire) == m_slots.size()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Clip first so the size check and the copy agree.
+    std::array<CaptureRect, MAX_RECTS> clipped{};
+    uint32_t count = 0;
+    size_t payload = 0;
+    for (const CaptureRect &r : rects) {
+        const int32_t x0 = std::max(r.x, 0);
+        const int32_t y0 = std::max(r.y, 0);
+        const int32_t x1 = std::min(r.x + r.width, surface.width);
+        const int32_t y1 = std::min(r.y + r.height, surface.height);
+        if (x1 <= x0 || y1 <= y0) continue;
+        if (count == MAX_RECTS) {
+            // Too fragmented to be worth tracking: take the whole buffer.
+            count = 0;
+            clipped[count++] = CaptureRect{.width = surface.width, .height = surface.height};
+            payload = static_cast<size_t>(surface.width) * surface.height * sizeof(uint32_t);
+            break;
+        }
+        clipped[count++] = CaptureRect{.x = x0, .y = y0, .width = x1 - x0, .height = y1 - y0};
+        payload += static_cast<size_t>(x1 - x0) * (y1 - y0) * sizeof(uint32_t);
+    }
+    if (count == 0) return;
+
+    const size_t bytes = sizeof(RecordHeader) + count * sizeof(CaptureRect) + payload;
+    if (bytes > m_slotBytes) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::byte *out = m_staging.data() + (head % m_slots.size()) * m_slotBytes;
+    const RecordHeader header{
+        .surfaceId = surface.id,
+        .parentId = surface.parentId,
+        .x = surface.x,
+        .y = surface.y,
+        .width = surface.width,
+        .height = surface.height,
+        .pixelFormat = surface.pixelFormat,
+        .rectCount = count,
+        .timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count()),
+        .payloadBytes = payload,
+    };
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memcpy(out, clipped.data(), count * sizeof(CaptureRect));
+    out += count * sizeof(CaptureRect);
+
+    const auto *src = static_cast<const std::byte *>(surface.pixels);
+    for (uint32_t i = 0; i < count; ++i) {
+        const CaptureRect &r = clipped[i];
+        const size_t rowBytes = static_cast<size_t>(r.width) * sizeof(uint32_t);
+        for (int32_t y = r.y; y < r.y + r.height; ++y) {
+            std::memcpy(out, src + static_cast<size_t>(y) * surface.stride + static_cast<size_t>(r.x) * sizeof(uint32_t), rowBytes);
+            out += rowBytes;
+        }
+    }
+
+    m_slots[head % m_slots.size()].bytes = bytes;
+    m_head.store(head + 1, std::memory_order_release);
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+}
+
+wm::CaptureStats FrameCapture::stats() const
+{
+    return wm::CaptureStats{
+        .framesCaptured = m_captured.load(std::memory_order_relaxed),
+        .framesWritten = m_written.load(std::memory_order_relaxed),
+        .framesDropped = m_dropped.load(std::memory_order_relaxed),
+        .bytesWritten = m_bytesWritten.load(std::memory_order_relaxed),
+    };
+}
+
+void FrameCapture::writer_loop()
+{
+    for (;;) {
+        // Read the signal before draining so a submit in between wakes us.
+        const uint32_t seen = m_signal.load(std::memory_order_acquire);
+        drain();
+        if (m_stop.load(std::memory_order_acquire)) {
+            drain();
+            return;
+        }
+        m_signal.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void FrameCapture::drain()
+{
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    while (tail != head) {
+        const size_t index = tail % m_slots.size();
+        write_slot(m_staging.data() + index * m_slotBytes, m_slots[index].bytes);
+        m_tail.store(++tail, std::memory_order_release);
+    }
+}
+
+void FrameCapture::write_slot(const std::byte *data, const size_t bytes)
+{
+    if (m_failed.load(std::memory_order_relaxed)) return;
+
+    bool ok = true;
+    if (m_format == wm::CaptureFormat::Raw) {
+        ok = write_all(data, bytes);
+    } else {
+        RecordHeader header{};
+        std::memcpy(&header, data, sizeof(header));
+        const size_t rectBytes = header.rectCount * sizeof(CaptureRect);
+        const std::byte *pixels = data + sizeof(header) + rectBytes;
+        const size_t count = header.payloadBytes / sizeof(uint32_t);
+
+        // Runs never span rects: each rect's pixels are contiguous and
+        // whole in the slot, so a reader can split the stream by rect size.
+        size_t encoded = 0;
+        const std::byte *rects = data + sizeof(header);
+        size_t offset = 0;
+        for (uint32_t i = 0; i < header.rectCount; ++i) {
+            CaptureRect r{};
+            std::memcpy(&r, rects + i * sizeof(CaptureRect), sizeof(r));
+            const size_t end = offset + static_cast<size_t>(r.width) * r.height;
+            while (offset < end && offset < count) {
+                uint32_t pixel = 0;
+                std::memcpy(&pixel, pixels + offset * sizeof(uint32_t), sizeof(pixel));
+                uint32_t run = 1;
+                while (offset + run < end) {
+                    uint32_t next = 0;
+                    std::memcpy(&next, pixels + (offset + run) * sizeof(uint32_t), sizeof(next));
+                    if (next != pixel) break;
+                    ++run;
+                }
+                m_encoded[encoded++] = run;
+                m_encoded[encoded++] = pixel;
+                offset += run;
+            }
+        }
+
+        header.payloadBytes = encoded * sizeof(uint32_t);
+        ok = write_all(&header, sizeof(header))
+            && write_all(data + sizeof(header), rectBytes)
+            && write_all(m_encoded.data(), header.payloadBytes);
+    }
+
+    if (!ok) {
+        // Disk full or similar: stop writing; submit() counts the rest as drops.
+        m_failed.store(true, std::memory_order_relaxed);
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool FrameCapture::write_all(const void *data, size_t bytes)
+{
+    const auto *p = static_cast<const std::byte *>(data);
+    while (bytes > 0) {
+        const ssize_t n = write(m_fd, p, bytes);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        bytes -= static_cast<size_t>(n);
+        m_bytesWritten.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "window_manager/window_manager.hpp"
+
+namespace wm::capture_impl {
+
+struct CaptureRect {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+};
+
+// File layout: one FileHeader, then per committed frame a RecordHeader,
+// rectCount CaptureRects and the pixels of each rect in the same order
+// (rows of uint32 for Raw, (count, pixel) uint32 pairs for RunLength).
+struct FileHeader {
+    char magic[8] = {'W', 'M', 'C', 'A', 'P', 'T', 0, 0};
+    uint32_t version = 1;
+    uint32_t format = 0;
+};
+
+struct RecordHeader {
+    uint32_t surfaceId = 0;
+    // 0 for a toplevel; otherwise the surface this one is placed on.
+    uint32_t parentId = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    // wl_shm format of the source buffer.
+    uint32_t pixelFormat = 0;
+    uint32_t rectCount = 0;
+    uint64_t timestampNs = 0;
+    uint64_t payloadBytes = 0;
+};
+
+struct CaptureSurface {
+    uint32_t id = 0;
+    uint32_t parentId = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+    int width = 0;
+    int height = 0;
+    // In bytes.
+    int stride = 0;
+    uint32_t pixelFormat = 0;
+    const void *pixels = nullptr;
+};
+
+// Single-producer ring between the render thread (submit) and one writer
+// thread. Slots are carved out of one allocation made in start(); submit()
+// only copies and bumps a counter, so a slow disk costs dropped frames, not
+// frame time. Run-length encoding happens on the writer side.
+class FrameCapture {
+public:
+    // Damage rects kept per record; more collapse into one full rect.
+    static constexpr size_t MAX_RECTS = 16;
+
+    explicit FrameCapture(std::pmr::memory_resource *resource);
+    ~FrameCapture();
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    bool start(const wm::CaptureConfig &config);
+    void stop();
+
+    void submit(const CaptureSurface &surface, std::span<const CaptureRect> rects);
+    wm::CaptureStats stats() const;
+
+private:
+    struct Slot {
+        size_t bytes = 0;
+    };
+
+    void writer_loop();
+    void drain();
+    void write_slot(const std::byte *data, size_t bytes);
+    bool write_all(const void *data, size_t bytes);
+
+    wm::CaptureFormat m_format = wm::CaptureFormat::Raw;
+    int m_fd = -1;
+    size_t m_slotBytes = 0;
+    std::pmr::vector<std::byte> m_staging;
+    std::pmr::vector<Slot> m_slots;
+    // Writer-side scratch for run-length output, sized in start().
+    std::pmr::vector<uint32_t> m_encoded;
+    std::thread m_writer;
+
+    std::atomic<uint64_t> m_head{0};
+    std::atomic<uint64_t> m_tail{0};
+    std::atomic<uint32_t> m_signal{0};
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_failed{false};
+
+    std::atomic<uint64_t> m_captured{0};
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_bytesWritten{0};
+};
+
+}
@@ -0,0 +1,299 @@
+#include "window_manager/vulkan_surface.hpp"
+
+#include <algorithm>
+
+namespace wm {
+
+template <class Fn>
+static bool load_instance_fn(VkInstance instance, const char *name, Fn &fn)
+{
+    fn = reinterpret_cast<Fn>(vkGetInstanceProcAddr(instance, name));
+    return fn != nullptr;
+}
+
+template <class Fn>
+static bool load_device_fn(PFN_vkGetDeviceProcAddr getDeviceProcAddr, VkDevice device, const char *name, Fn &fn)
+{
+    fn = reinterpret_cast<Fn>(getDeviceProcAddr(device, name));
+    return fn != nullptr;
+}
+
+bool VulkanDispatch::load(VkInstance inst, VkDevice dev)
+{
+    instance = inst;
+    device = dev;
+
+    bool ok = load_instance_fn(inst, "vkDestroySurfaceKHR", destroySurface);
+    ok &= load_instance_fn(inst, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR", getSurfaceCapabilities);
+    ok &= load_instance_fn(inst, "vkGetPhysicalDeviceSurfaceFormatsKHR", getSurfaceFormats);
+    ok &= load_instance_fn(inst, "vkGetPhysicalDeviceSurfacePresentModesKHR", getSurfacePresentModes);
+
+    // Device-level entry points skip the loader trampoline.
+    PFN_vkGetDeviceProcAddr getDeviceProcAddr = nullptr;
+    if (!load_instance_fn(inst, "vkGetDeviceProcAddr", getDeviceProcAddr)) return false;
+    ok &= load_device_fn(getDeviceProcAddr, dev, "vkCreateSwapchainKHR", createSwapchain);
+    ok &= load_device_fn(getDeviceProcAddr, dev, "vkDestroySwapchainKHR", destroySwapchain);
+    ok &= load_device_fn(getDeviceProcAddr, dev, "vkGetSwapchainImagesKHR", getSwapchainImages);
+    ok &= load_device_fn(getDeviceProcAddr, dev, "vkAcquireNextImageKHR", acquireNextImage);
+    ok &= load_device_fn(getDeviceProcAddr, dev, "vkQueuePresentKHR", queuePresent);
+    ok &= load_device_fn(getDeviceProcAddr, dev, "vkDeviceWaitIdle", deviceWaitIdle);
+    return ok;
+}
+
+VulkanWindowSurface::~VulkanWindowSurface()
+{
+    destroy();
+}
+
+VkResult VulkanWindowSurface::init(
+    const WindowManager &mgr,
+    Window &window,
+    const VulkanDispatch &dispatch,
+    const VulkanSwapchainConfig &config,
+    const VkAllocationCallbacks *allocator
+)
+{
+    destroy();
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    const VkResult res = mgr.createVulkanWindowSurface(dispatch.instance, window, allocator, &surface);
+    if (res != VK_SUCCESS) return res;
+    const auto extent = [](const void *ctx) {
+        const auto &win = *static_cast<const Window *>(ctx);
+        return VkExtent2D{
+            static_cast<uint32_t>(std::max(win.getWidth(), 0)),
+            static_cast<uint32_t>(std::max(win.getHeight(), 0)),
+        };
+    };
+    adopt(surface, extent, &window, dispatch, config, allocator);
+    return VK_SUCCESS;
+}
+
+void VulkanWindowSurface::adopt(
+    VkSurfaceKHR surface,
+    const ExtentFn extentFn,
+    const void *extentCtx,
+    const VulkanDispatch &dispatch,
+    const VulkanSwapchainConfig &config,
+    const VkAllocationCallbacks *allocator
+)
+{
+    m_dispatch = &dispatch;
+    m_allocator = allocator;
+    m_extentFn = extentFn;
+    m_extentCtx = extentCtx;
+    m_config = config;
+    m_surface = surface;
+
+    // Supported formats and present modes are fixed for the surface's
+    // lifetime, so they are queried once here rather than per recreation.
+    uint32_t count = 0;
+    dispatch.getSurfaceFormats(config.physicalDevice, m_surface, &count, nullptr);
+    m_formats.resize(count);
+    dispatch.getSurfaceFormats(config.physicalDevice, m_surface, &count, m_formats.data());
+
+    count = 0;
+    dispatch.getSurfacePresentModes(config.physicalDevice, m_surface, &count, nullptr);
+    m_presentModes.resize(count);
+    dispatch.getSurfacePresentModes(config.physicalDevice, m_surface, &count, m_presentModes.data());
+
+    m_format = choose_format();
+    m_presentMode = choose_present_mode();
+    m_dirty = true;
+}
+
+void VulkanWindowSurface::destroy()
+{
+    if (!m_dispatch) return;
+    release_retired(true);
+    if (m_swapchain) {
+        m_dispatch->destroySwapchain(m_dispatch->device, m_swapchain, m_allocator);
+        m_swapchain = VK_NULL_HANDLE;
+    }
+    if (m_surface) {
+        m_dispatch->destroySurface(m_dispatch->instance, m_surface, m_allocator);
+        m_surface = VK_NULL_HANDLE;
+    }
+    m_images.clear();
+    m_dispatch = nullptr;
+    m_extentFn = nullptr;
+    m_extentCtx = nullptr;
+}
+
+void VulkanWindowSurface::suspend()
+{
+    if (m_dispatch && m_swapchain) {
+        retire(m_swapchain, static_cast<uint32_t>(m_images.size()));
+        m_swapchain = VK_NULL_HANDLE;
+        m_images.clear();
+        ++m_generation;
+    }
+    m_suspended = true;
+}
+
+VkSurfaceFormatKHR VulkanWindowSurface::choose_format() const
+{
+    for (const auto &fmt : m_formats) {
+        if (fmt.format == m_config.preferredFormat && fmt.colorSpace == m_config.preferredColorSpace) {
+            return fmt;
+        }
+    }
+    if (!m_formats.empty()) return m_formats.front();
+    return VkSurfaceFormatKHR{m_config.preferredFormat, m_config.preferredColorSpace};
+}
+
+VkPresentModeKHR VulkanWindowSurface::choose_present_mode() const
+{
+    const auto supported = [this](const VkPresentModeKHR mode) {
+        return std::find(m_presentModes.begin(), m_presentModes.end(), mode) != m_presentModes.end();
+    };
+    switch (m_config.presentMode) {
+        case PresentModePreference::LowLatency:
+            if (supported(VK_PRESENT_MODE_MAILBOX_KHR)) return VK_PRESENT_MODE_MAILBOX_KHR;
+            if (supported(VK_PRESENT_MODE_FIFO_RELAXED_KHR)) return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        case PresentModePreference::Relaxed:
+            if (supported(VK_PRESENT_MODE_FIFO_RELAXED_KHR)) return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        case PresentModePreference::Immediate:
+            if (supported(VK_PRESENT_MODE_IMMEDIATE_KHR)) return VK_PRESENT_MODE_IMMEDIATE_KHR;
+            if (supported(VK_PRESENT_MODE_MAILBOX_KHR)) return VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case PresentModePreference::Vsync:
+            break;
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkResult VulkanWindowSurface::recreate()
+{
+    VkSurfaceCapabilitiesKHR caps{};
+    VkResult res = m_dispatch->getSurfaceCapabilities(m_config.physicalDevice, m_surface, &caps);
+    if (res != VK_SUCCESS) return res;
+
+    const VkExtent2D requested = m_extentFn(m_extentCtx);
+    // Wayland reports currentExtent as 0xFFFFFFFF: the window size decides.
+    VkExtent2D extent = caps.currentExtent;
+    if (extent.width == UINT32_MAX) extent = requested;
+    extent.width = std::clamp(extent.width, caps.minImageExtent.width, caps.maxImageExtent.width);
+    extent.height = std::clamp(extent.height, caps.minImageExtent.height, caps.maxImageExtent.height);
+    if (extent.width == 0 || extent.height == 0) return VK_NOT_READY;
+
+    uint32_t imageCount = std::max(m_config.minImageCount, caps.minImageCount);
+    if (caps.maxImageCount > 0) imageCount = std::min(imageCount, caps.maxImageCount);
+
+    VkSwapchainCreateInfoKHR info{};
+    info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    info.surface = m_surface;
+    info.minImageCount = imageCount;
+    info.imageFormat = m_format.format;
+    info.imageColorSpace = m_format.colorSpace;
+    info.imageExtent = extent;
+    info.imageArrayLayers = 1;
+    info.imageUsage = m_config.imageUsage;
+    info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.preTransform = caps.currentTransform;
+    info.compositeAlpha = (caps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR)
+                          ? VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR
+                          : VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+    info.presentMode = m_presentMode;
+    info.clipped = VK_TRUE;
+    // Handing over the old swapchain lets the driver reuse its images and
+    // keeps presenting during a resize instead of stalling.
+    info.oldSwapchain = m_swapchain;
+
+    VkSwapchainKHR next = VK_NULL_HANDLE;
+    res = m_dispatch->createSwapchain(m_dispatch->device, &info, m_allocator, &next);
+    if (m_swapchain) {
+        retire(m_swapchain, static_cast<uint32_t>(m_images.size()));
+    }
+    m_swapchain = next;
+    if (res != VK_SUCCESS) {
+        m_swapchain = VK_NULL_HANDLE;
+        m_images.clear();
+        return res;
+    }
+
+    uint32_t count = 0;
+    m_dispatch->getSwapchainImages(m_dispatch->device, m_swapchain, &count, nullptr);
+    m_images.resize(count);
+    m_dispatch->getSwapchainImages(m_dispatch->device, m_swapchain, &count, m_images.data());
+
+    m_extent = extent;
+    m_requested = requested;
+    m_dirty = false;
+    ++m_generation;
+    return VK_SUCCESS;
+}
+
+void VulkanWindowSurface::retire(VkSwapchainKHR swapchain, const uint32_t imageCount)
+{
+    for (auto &slot : m_retired) {
+        if (!slot.swapchain) {
+            slot = Retired{.swapchain = swapchain, .presentsLeft = std::max(imageCount, 1u)};
+            return;
+        }
+    }
+    // Resizing faster than frames retire: drain the device once and start over.
+    m_dispatch->deviceWaitIdle(m_dispatch->device);
+    release_retired(true);
+    m_dispatch->destroySwapchain(m_dispatch->device, swapchain, m_allocator);
+}
+
+void VulkanWindowSurface::release_retired(const bool all)
+{
+    for (auto &slot : m_retired) {
+        if (!slot.swapchain) continue;
+        if (!all && --slot.presentsLeft > 0) continue;
+        m_dispatch->destroySwapchain(m_dispatch->device, slot.swapchain, m_allocator);
+        slot = Retired{};
+    }
+}
+
+VkResult VulkanWindowSurface::acquire(const uint64_t timeout, VkSemaphore signal, VkFence fence, uint32_t *imageIndex)
+{
+    if (!m_dispatch || !m_surface) return VK_ERROR_INITIALIZATION_FAILED;
+    if (m_suspended) return VK_NOT_READY;
+
+    const VkExtent2D size = m_extentFn(m_extentCtx);
+    if (size.width == 0 || size.height == 0) return VK_NOT_READY;
+    if (size.width != m_requested.width || size.height != m_requested.height) {
+        m_dirty = true;
+    }
+
+    if (m_dirty || !m_swapchain) {
+        const VkResult res = recreate();
+        if (res != VK_SUCCESS) return res;
+    }
+
+    VkResult res = m_dispatch->acquireNextImage(m_dispatch->device, m_swapchain, timeout, signal, fence, imageIndex);
+    if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+        m_dirty = true;
+    } else if (res == VK_SUBOPTIMAL_KHR) {
+        // The acquired image is still usable; rebuild before the next one.
+        m_dirty = true;
+        res = VK_SUCCESS;
+    }
+    return res;
+}
+
+VkResult VulkanWindowSurface::present(VkQueue queue, const uint32_t imageIndex, const std::span<const VkSemaphore> waits)
+{
+    if (!m_dispatch || !m_swapchain) return VK_ERROR_INITIALIZATION_FAILED;
+
+    VkPresentInfoKHR info{};
+    info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    info.waitSemaphoreCount = static_cast<uint32_t>(waits.size());
+    info.pWaitSemaphores = waits.data();
+    info.swapchainCount = 1;
+    info.pSwapchains = &m_swapchain;
+    info.pImageIndices = &imageIndex;
+
+    const VkResult res = m_dispatch->queuePresent(queue, &info);
+    release_retired(false);
+    if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
+        m_dirty = true;
+    }
+    return res;
+}
+
+}
@@ -0,0 +1,375 @@
+#include "wayland_cursor.hpp"
+#include "window_manager/wayland/wayland_window_manager.hpp"
+
+#ifdef WM_HAVE_CURSOR_SHAPE
+#include <cursor-shape-v1-client-protocol.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace wm::wayland_impl {
+
+namespace {
+
+// Primary name first, then legacy X11 names some themes still only ship.
+struct CursorNames {
+    const char *names[3];
+};
+
+constexpr std::array<CursorNames, static_cast<size_t>(wm::CursorShape::Count)> CURSOR_NAMES = {{
+    {{"default", "left_ptr", nullptr}},
+    {{"text", "xterm", nullptr}},
+    {{"pointer", "hand2", "hand1"}},
+    {{"crosshair", "cross", nullptr}},
+    {{"move", "fleur", nullptr}},
+    {{"wait", "watch", nullptr}},
+    {{"progress", "left_ptr_watch", nullptr}},
+    {{"not-allowed", "crossed_circle", nullptr}},
+    {{"grab", "openhand", nullptr}},
+    {{"grabbing", "closedhand", nullptr}},
+    {{"ns-resize", "sb_v_double_arrow", nullptr}},
+    {{"ew-resize", "sb_h_double_arrow", nullptr}},
+    {{"nwse-resize", "bd_double_arrow", nullptr}},
+    {{"nesw-resize", "fd_double_arrow", nullptr}},
+    {{nullptr, nullptr, nullptr}},
+}};
+
+constexpr uint32_t XCURSOR_MAGIC = 0x72756358; // "Xcur"
+constexpr uint32_t XCURSOR_IMAGE_TYPE = 0xfffd0002;
+constexpr uint32_t XCURSOR_IMAGE_HEADER = 36;
+constexpr uint32_t XCURSOR_MAX_DIMENSION = 0x7fff;
+
+uint32_t read_u32(const std::pmr::vector<unsigned char> &buf, const size_t offset)
+{
+    uint32_t v = 0;
+    std::memcpy(&v, buf.data() + offset, sizeof(v));
+    return v;
+}
+
+bool read_file(const char *path, std::pmr::vector<unsigned char> &out)
+{
+    FILE *f = std::fopen(path, "rb");
+    if (!f) return false;
+    bool ok = std::fseek(f, 0, SEEK_END) == 0;
+    const long size = ok ? std::ftell(f) : -1;
+    ok = ok && size > 0 && std::fseek(f, 0, SEEK_SET) == 0;
+    if (ok) {
+        out.resize(static_cast<size_t>(size));
+        ok = std::fread(out.data(), 1, out.size(), f) == out.size();
+    }
+    std::fclose(f);
+    return ok;
+}
+
+#ifdef WM_HAVE_CURSOR_SHAPE
+uint32_t to_shape_protocol(const wm::CursorShape shape)
+{
+    switch (shape) {
+        case wm::CursorShape::Text: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_TEXT;
+        case wm::CursorShape::Pointer: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_POINTER;
+        case wm::CursorShape::Crosshair: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_CROSSHAIR;
+        case wm::CursorShape::Move: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_MOVE;
+        case wm::CursorShape::Wait: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_WAIT;
+        case wm::CursorShape::Progress: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_PROGRESS;
+        case wm::CursorShape::NotAllowed: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_NOT_ALLOWED;
+        case wm::CursorShape::Grab: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_GRAB;
+        case wm::CursorShape::Grabbing: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_GRABBING;
+        case wm::CursorShape::ResizeNS: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_NS_RESIZE;
+        case wm::CursorShape::ResizeEW: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_EW_RESIZE;
+        case wm::CursorShape::ResizeNWSE: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_NWSE_RESIZE;
+        case wm::CursorShape::ResizeNESW: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_NESW_RESIZE;
+        default: return WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_DEFAULT;
+    }
+}
+#endif
+
+}
+
+CursorAtlas::CursorAtlas(WaylandWindowManager &mgr, std::pmr::memory_resource *resource)
+    : m_mgr(mgr), m_resource(resource), m_theme(resource), m_searchPath(resource), m_frames(resource)
+{
+    const char *theme = std::getenv("XCURSOR_THEME");
+    m_theme.assign(theme && *theme ? theme : "default");
+    if (const char *size = std::getenv("XCURSOR_SIZE")) {
+        const int parsed = std::atoi(size);
+        if (parsed > 0) m_size = parsed;
+    }
+
+    const char *path = std::getenv("XCURSOR_PATH");
+    const char *home = std::getenv("HOME");
+    std::pmr::string dirs(m_resource);
+    if (path && *path) {
+        dirs.assign(path);
+    } else {
+        if (home) {
+            dirs.append(home).append("/.local/share/icons:");
+            dirs.append(home).append("/.icons:");
+        }
+        dirs.append("/usr/share/icons:/usr/share/pixmaps");
+    }
+    size_t start = 0;
+    while (start <= dirs.size()) {
+        const size_t end = std::min(dirs.find(':', start), dirs.size());
+        if (end > start) m_searchPath.emplace_back(dirs.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+CursorAtlas::~CursorAtlas()
+{
+    for (auto &f : m_frames) {
+        if (f.buffer) wl_buffer_destroy(f.buffer);
+    }
+    if (m_pool) wl_shm_pool_destroy(m_pool);
+    if (m_data) munmap(m_data, m_capacity);
+    if (m_fd >= 0) close(m_fd);
+}
+
+const CursorImage *CursorAtlas::get(const wm::CursorShape shape)
+{
+    const auto index = static_cast<size_t>(shape);
+    if (index >= m_images.size()) return nullptr;
+    CursorImage &img = m_images[index];
+    if (!img.attempted) {
+        img.attempted = true;
+        img.loaded = load(shape, img);
+    }
+    return img.loaded ? &img : nullptr;
+}
+
+bool CursorAtlas::load(const wm::CursorShape shape, CursorImage &out)
+{
+    std::pmr::string path(m_resource);
+    for (const char *name : CURSOR_NAMES[static_cast<size_t>(shape)].names) {
+        if (!name) break;
+        if ((find_in_theme(m_theme, name, 0, path) || find_in_theme("default", name, 0, path))
+            && load_file(path, out)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CursorAtlas::find_in_theme(const std::string_view theme, const std::string_view name, const int depth, std::pmr::string &path) const
+{
+    if (depth > 4) return false;
+    for (const auto &dir : m_searchPath) {
+        path.assign(dir).append("/").append(theme).append("/cursors/").append(name);
+        if (access(path.c_str(), R_OK) == 0) return true;
+    }
+
+    // Follow Inherits= from the first index.theme found.
+    std::pmr::vector<unsigned char> index(m_resource);
+    for (const auto &dir : m_searchPath) {
+        path.assign(dir).append("/").append(theme).append("/index.theme");
+        if (!read_file(path.c_str(), index)) continue;
+        const std::string_view text(reinterpret_cast<const char *>(index.data()), index.size());
+        const size_t key = text.find("Inherits");
+        if (key == std::string_view::npos) return false;
+        const size_t eq = text.find('=', key);
+        if (eq == std::string_view::npos) return false;
+        const size_t eol = std::min(text.find('\n', eq), text.size());
+        std::string_view list = text.substr(eq + 1, eol - eq - 1);
+        while (!list.empty()) {
+            const size_t sep = std::min(list.find_first_of(",;"), list.size());
+            std::string_view parent = list.substr(0, sep);
+            while (!parent.empty() && (parent.front() == ' ' || parent.front() == '\t')) parent.remove_prefix(1);
+            while (!parent.empty() && (parent.back() == ' ' || parent.back() == '\r')) parent.remove_suffix(1);
+            if (!parent.empty() && parent != theme) {
+                const std::pmr::string parentName(parent, m_resource);
+                if (find_in_theme(parentName, name, depth + 1, path)) return true;
+            }
+            list.remove_prefix(std::min(sep + 1, list.size()));
+        }
+        return false;
+    }
+    return false;
+}
+
+bool CursorAtlas::load_file(const std::pmr::string &path, CursorImage &out)
+{
+    std::pmr::vector<unsigned char> buf(m_resource);
+    if (!read_file(path.c_str(), buf) || buf.size() < 16) return false;
+    if (read_u32(buf, 0) != XCURSOR_MAGIC) return false;
+    const uint32_t headerSize = read_u32(buf, 4);
+    const uint32_t ntoc = read_u32(buf, 12);
+    if (headerSize < 16 || headerSize + static_cast<size_t>(ntoc) * 12 > buf.size()) return false;
+
+    // Pick the nominal size closest to the requested one; all chunks of
+    // that size are the animation frames, in file order.
+    uint32_t best = 0;
+    int bestDiff = -1;
+    for (uint32_t i = 0; i < ntoc; ++i) {
+        const size_t entry = headerSize + static_cast<size_t>(i) * 12;
+        if (read_u32(buf, entry) != XCURSOR_IMAGE_TYPE) continue;
+        const uint32_t size = read_u32(buf, entry + 4);
+        const int diff = std::abs(static_cast<int>(size) - m_size);
+        if (bestDiff < 0 || diff < bestDiff) {
+            best = size;
+            bestDiff = diff;
+        }
+    }
+    if (bestDiff < 0) return false;
+
+    // First pass validates and sizes the frames so the pool grows once.
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < ntoc; ++i) {
+        const size_t entry = headerSize + static_cast<size_t>(i) * 12;
+        if (read_u32(buf, entry) != XCURSOR_IMAGE_TYPE || read_u32(buf, entry + 4) != best) continue;
+        const size_t pos = read_u32(buf, entry + 8);
+        if (pos + XCURSOR_IMAGE_HEADER > buf.size()) return false;
+        const uint32_t width = read_u32(buf, pos + 16);
+        const uint32_t height = read_u32(buf, pos + 20);
+        if (width > XCURSOR_MAX_DIMENSION || height > XCURSOR_MAX_DIMENSION) return false;
+        const size_t pixels = static_cast<size_t>(width) * height * 4;
+        if (pos + XCURSOR_IMAGE_HEADER + pixels > buf.size()) return false;
+        bytes += pixels;
+    }
+    if (bytes == 0 || !reserve(bytes)) return false;
+
+    out.firstFrame = static_cast<uint32_t>(m_frames.size());
+    out.frameCount = 0;
+    for (uint32_t i = 0; i < ntoc; ++i) {
+        const size_t entry = headerSize + static_cast<size_t>(i) * 12;
+        if (read_u32(buf, entry) != XCURSOR_IMAGE_TYPE || read_u32(buf, entry + 4) != best) continue;
+        const size_t pos = read_u32(buf, entry + 8);
+        CursorFrame frame{
+            .width = static_cast<int>(read_u32(buf, pos + 16)),
+            .height = static_cast<int>(read_u32(buf, pos + 20)),
+            .hotspotX = static_cast<int>(read_u32(buf, pos + 24)),
+            .hotspotY = static_cast<int>(read_u32(buf, pos + 28)),
+            .delayMs = read_u32(buf, pos + 32),
+        };
+        const size_t pixels = static_cast<size_t>(frame.width) * frame.height * 4;
+        // Xcursor pixels are premultiplied ARGB32, which is ARGB8888 as-is.
+        std::memcpy(static_cast<unsigned char *>(m_data) + m_used, buf.data() + pos + XCURSOR_IMAGE_HEADER, pixels);
+        frame.buffer = wl_shm_pool_create_buffer(m_pool, static_cast<int32_t>(m_used), frame.width, frame.height,
+                                                 frame.width * 4, WL_SHM_FORMAT_ARGB8888);
+        m_used += pixels;
+        m_frames.push_back(frame);
+        ++out.frameCount;
+    }
+    return out.frameCount > 0;
+}
+
+bool CursorAtlas::reserve(const size_t bytes)
+{
+    if (m_used + bytes <= m_capacity) return true;
+    const size_t capacity = std::max({m_capacity * 2, m_used + bytes, static_cast<size_t>(64 * 1024)});
+
+    if (m_fd < 0) {
+        m_fd = create_shm_file(capacity);
+        if (m_fd < 0) return false;
+    } else if (ftruncate(m_fd, static_cast<off_t>(capacity)) < 0) {
+        return false;
+    }
+
+    void *data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) return false;
+    if (m_data) munmap(m_data, m_capacity);
+    m_data = data;
+
+    // Existing buffers keep their offsets; the pool only ever grows.
+    if (m_pool) {
+        wl_shm_pool_resize(m_pool, static_cast<int32_t>(capacity));
+    } else {
+        m_pool = wl_shm_create_pool(m_mgr.shm(), m_fd, static_cast<int32_t>(capacity));
+    }
+    m_capacity = capacity;
+    return true;
+}
+
+static constexpr wl_callback_listener CURSOR_FRAME_LISTENER = {
+    .done = WaylandCursor::handle_frame_done,
+};
+
+WaylandCursor::WaylandCursor(WaylandWindowManager &mgr, wl_pointer *pointer, wp_cursor_shape_manager_v1 *shapeManager)
+    : m_mgr(mgr), m_pointer(pointer), m_atlas(mgr, mgr.getMemoryResource())
+{
+#ifdef WM_HAVE_CURSOR_SHAPE
+    if (shapeManager) m_shapeDevice = wp_cursor_shape_manager_v1_get_pointer(shapeManager, pointer);
+#else
+    (void)shapeManager;
+#endif
+    if (!m_shapeDevice) m_surface = wl_compositor_create_surface(mgr.compositor());
+}
+
+WaylandCursor::~WaylandCursor()
+{
+    if (m_frameCallback) wl_callback_destroy(m_frameCallback);
+#ifdef WM_HAVE_CURSOR_SHAPE
+    if (m_shapeDevice) wp_cursor_shape_device_v1_destroy(m_shapeDevice);
+#endif
+    if (m_surface) wl_surface_destroy(m_surface);
+}
+
+void WaylandCursor::apply(const wm::CursorShape shape, const uint32_t serial)
+{
+    m_serial = serial;
+    m_shape = shape;
+    if (shape == wm::CursorShape::Hidden) {
+        m_current = nullptr;
+        wl_pointer_set_cursor(m_pointer, serial, nullptr, 0, 0);
+        return;
+    }
+
+#ifdef WM_HAVE_CURSOR_SHAPE
+    if (m_shapeDevice) {
+        wp_cursor_shape_device_v1_set_shape(m_shapeDevice, serial, to_shape_protocol(shape));
+        return;
+    }
+#endif
+
+    const CursorImage *img = m_atlas.get(shape);
+    if (!img) img = m_atlas.get(wm::CursorShape::Default);
+    m_current = img;
+    if (!img) return;
+    m_frameIndex = 0;
+    m_frameStartValid = false;
+    show_frame(0);
+    if (img->frameCount > 1) schedule_frame();
+}
+
+void WaylandCursor::show_frame(const uint32_t index)
+{
+    const CursorFrame &f = m_atlas.frame(m_current->firstFrame + index);
+    wl_pointer_set_cursor(m_pointer, m_serial, m_surface, f.hotspotX, f.hotspotY);
+    wl_surface_attach(m_surface, f.buffer, 0, 0);
+    wl_surface_damage(m_surface, 0, 0, f.width, f.height);
+    wl_surface_commit(m_surface);
+}
+
+void WaylandCursor::schedule_frame()
+{
+    if (m_frameCallback || !m_surface) return;
+    m_frameCallback = wl_surface_frame(m_surface);
+    wl_callback_add_listener(m_frameCallback, &CURSOR_FRAME_LISTENER, this);
+    wl_surface_commit(m_surface);
+}
+
+void WaylandCursor::handle_frame_done(void *data, wl_callback *callback, const uint32_t time)
+{
+    auto *self = static_cast<WaylandCursor *>(data);
+    wl_callback_destroy(callback);
+    self->m_frameCallback = nullptr;
+    if (!self->m_current || self->m_current->frameCount < 2) return;
+
+    if (!self->m_frameStartValid) {
+        self->m_frameStart = time;
+        self->m_frameStartValid = true;
+    }
+    const CursorFrame &f = self->m_atlas.frame(self->m_current->firstFrame + self->m_frameIndex);
+    if (time - self->m_frameStart >= f.delayMs) {
+        self->m_frameIndex = (self->m_frameIndex + 1) % self->m_current->frameCount;
+        self->m_frameStart = time;
+        self->show_frame(self->m_frameIndex);
+    }
+    self->schedule_frame();
+}
+
+}
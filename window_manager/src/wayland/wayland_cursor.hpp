@@ -0,0 +1,103 @@
+#pragma once
+
+#include <wayland-client.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "window_manager/window_manager.hpp"
+
+struct wp_cursor_shape_manager_v1;
+struct wp_cursor_shape_device_v1;
+
+namespace wm::wayland_impl {
+
+class WaylandWindowManager;
+
+struct CursorFrame {
+    wl_buffer *buffer = nullptr;
+    int width = 0;
+    int height = 0;
+    int hotspotX = 0;
+    int hotspotY = 0;
+    uint32_t delayMs = 0;
+};
+
+struct CursorImage {
+    bool attempted = false;
+    bool loaded = false;
+    // Index of the first frame in the atlas frame list and how many follow.
+    uint32_t firstFrame = 0;
+    uint32_t frameCount = 0;
+};
+
+// Xcursor images for the shapes actually requested, packed into a single
+// wl_shm_pool that grows on demand. The theme is resolved once per manager;
+// each shape is read from disk the first time it is shown.
+class CursorAtlas {
+public:
+    CursorAtlas(WaylandWindowManager &mgr, std::pmr::memory_resource *resource);
+    ~CursorAtlas();
+
+    const CursorImage *get(wm::CursorShape shape);
+    const CursorFrame &frame(uint32_t index) const { return m_frames[index]; }
+
+private:
+    bool load(wm::CursorShape shape, CursorImage &out);
+    bool load_file(const std::pmr::string &path, CursorImage &out);
+    bool find_in_theme(std::string_view theme, std::string_view name, int depth, std::pmr::string &path) const;
+    bool reserve(size_t bytes);
+
+    WaylandWindowManager &m_mgr;
+    std::pmr::memory_resource *m_resource = nullptr;
+    std::pmr::string m_theme;
+    int m_size = 24;
+    std::pmr::vector<std::pmr::string> m_searchPath;
+
+    int m_fd = -1;
+    void *m_data = nullptr;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+    wl_shm_pool *m_pool = nullptr;
+
+    std::pmr::vector<CursorFrame> m_frames;
+    std::array<CursorImage, static_cast<size_t>(wm::CursorShape::Count)> m_images{};
+};
+
+// One cursor surface for the seat's pointer. Prefers wp_cursor_shape_v1 and
+// falls back to the atlas; animated cursors advance on frame callbacks of
+// the cursor surface.
+class WaylandCursor {
+public:
+    WaylandCursor(WaylandWindowManager &mgr, wl_pointer *pointer, wp_cursor_shape_manager_v1 *shapeManager);
+    ~WaylandCursor();
+
+    void apply(wm::CursorShape shape, uint32_t serial);
+
+    static void handle_frame_done(void *data, wl_callback *callback, uint32_t time);
+
+private:
+    void show_frame(uint32_t index);
+    void schedule_frame();
+
+    WaylandWindowManager &m_mgr;
+    wl_pointer *m_pointer = nullptr;
+    wp_cursor_shape_device_v1 *m_shapeDevice = nullptr;
+    wl_surface *m_surface = nullptr;
+    wl_callback *m_frameCallback = nullptr;
+    CursorAtlas m_atlas;
+
+    const CursorImage *m_current = nullptr;
+    wm::CursorShape m_shape = wm::CursorShape::Count;
+    uint32_t m_serial = 0;
+    uint32_t m_frameIndex = 0;
+    uint32_t m_frameStart = 0;
+    bool m_frameStartValid = false;
+};
+
+}
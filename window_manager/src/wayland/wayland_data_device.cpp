@@ -0,0 +1,562 @@
+#include "wayland_data_device.hpp"
+#include "window_manager/wayland/wayland_window_manager.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wm::wayland_impl {
+
+static constexpr wl_data_device_listener DATA_DEVICE_LISTENER = {
+    .data_offer = WaylandDataDevice::handle_data_offer,
+    .enter = WaylandDataDevice::handle_enter,
+    .leave = WaylandDataDevice::handle_leave,
+    .motion = WaylandDataDevice::handle_motion,
+    .drop = WaylandDataDevice::handle_drop,
+    .selection = WaylandDataDevice::handle_selection,
+};
+
+static constexpr wl_data_offer_listener DATA_OFFER_LISTENER = {
+    .offer = WaylandDataDevice::handle_offer_offer,
+    .source_actions = WaylandDataDevice::handle_offer_source_actions,
+    .action = WaylandDataDevice::handle_offer_action,
+};
+
+static constexpr wl_data_source_listener DATA_SOURCE_LISTENER = {
+    .target = WaylandDataDevice::handle_source_target,
+    .send = WaylandDataDevice::handle_source_send,
+    .cancelled = WaylandDataDevice::handle_source_cancelled,
+    .dnd_drop_performed = WaylandDataDevice::handle_source_dnd_drop_performed,
+    .dnd_finished = WaylandDataDevice::handle_source_dnd_finished,
+    .action = WaylandDataDevice::handle_source_action,
+};
+
+// Blocks SIGPIPE on this thread while writing to a pipe whose reader may be
+// gone, then swallows the one the write raised. The process-wide
+// disposition belongs to the application and is left alone.
+class SigpipeGuard {
+public:
+    SigpipeGuard()
+    {
+        sigset_t pending;
+        sigemptyset(&pending);
+        sigpending(&pending);
+        m_wasPending = sigismember(&pending, SIGPIPE) == 1;
+        sigset_t block;
+        sigemptyset(&block);
+        sigaddset(&block, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &block, &m_old);
+    }
+    ~SigpipeGuard()
+    {
+        // A SIGPIPE pending from before is not ours to consume.
+        if (!m_wasPending) {
+            const int savedErrno = errno;
+            sigset_t pipe;
+            sigemptyset(&pipe);
+            sigaddset(&pipe, SIGPIPE);
+            const timespec zero{};
+            while (sigtimedwait(&pipe, nullptr, &zero) < 0 && errno == EINTR) {}
+            errno = savedErrno;
+        }
+        pthread_sigmask(SIG_SETMASK, &m_old, nullptr);
+    }
+    SigpipeGuard(const SigpipeGuard &) = delete;
+    SigpipeGuard &operator=(const SigpipeGuard &) = delete;
+
+private:
+    sigset_t m_old{};
+    bool m_wasPending = false;
+};
+
+static bool has_input(const int fd)
+{
+    pollfd p{.fd = fd, .events = POLLIN, .revents = 0};
+    return poll(&p, 1, 0) > 0 && (p.revents & (POLLIN | POLLHUP));
+}
+
+static bool set_nonblocking(const int fd)
+{
+    const int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+WaylandDataDevice::WaylandDataDevice(WaylandWindowManager &mgr, wl_data_device_manager *manager, const uint32_t version)
+    : m_mgr(mgr), m_resource(mgr.getMemoryResource()), m_manager(manager), m_version(version),
+      m_newOffers(m_resource), m_transfers(m_resource), m_deferred(m_resource), m_chunk(CHUNK_SIZE, m_resource)
+{
+    m_transfers.reserve(8);
+    m_deferred.reserve(8);
+}
+
+WaylandDataDevice::~WaylandDataDevice()
+{
+    m_inService = true;
+    for (auto &t : m_transfers) {
+        if (!t.finished) finish(t, wm::TransferStatus::Failed);
+    }
+    for (auto &t : m_deferred) {
+        if (!t.finished) finish(t, wm::TransferStatus::Failed);
+    }
+    for (auto *state : m_newOffers) destroy_offer(state);
+    destroy_offer(m_selection);
+    destroy_offer(m_drag);
+    destroy_offer(m_dropped);
+    if (m_source) wl_data_source_destroy(m_source);
+    if (m_device) {
+        if (m_version >= 2) wl_data_device_release(m_device);
+        else wl_data_device_destroy(m_device);
+    }
+    if (m_manager) wl_data_device_manager_destroy(m_manager);
+}
+
+void WaylandDataDevice::bindSeat(wl_seat *seat)
+{
+    if (m_device || !seat) return;
+    m_device = wl_data_device_manager_get_data_device(m_manager, seat);
+    wl_data_device_add_listener(m_device, &DATA_DEVICE_LISTENER, this);
+}
+
+void WaylandDataDevice::forgetWindow(const WaylandWindow *window)
+{
+    if (m_dragWindow == window) m_dragWindow = nullptr;
+}
+
+void WaylandDataDevice::destroy_offer(DataOfferState *&state)
+{
+    if (!state) return;
+    if (state->offer) wl_data_offer_destroy(state->offer);
+    std::pmr::polymorphic_allocator<DataOfferState>(m_resource).delete_object(state);
+    state = nullptr;
+}
+
+std::span<const std::pmr::string> WaylandDataDevice::clipboardMimeTypes() const
+{
+    if (!m_selection) return {};
+    return m_selection->mimeTypes;
+}
+
+std::span<const std::pmr::string> WaylandDataDevice::dropMimeTypes() const
+{
+    const DataOfferState *state = m_drag ? m_drag : m_dropped;
+    if (!state) return {};
+    return state->mimeTypes;
+}
+
+void WaylandDataDevice::acceptDrop(const std::string_view mimeType)
+{
+    if (!m_drag) return;
+    // wl_data_offer_accept needs a NUL-terminated type; reuse the offer's own string.
+    const auto it = std::find(m_drag->mimeTypes.begin(), m_drag->mimeTypes.end(), mimeType);
+    wl_data_offer_accept(m_drag->offer, m_dragSerial, it != m_drag->mimeTypes.end() ? it->c_str() : nullptr);
+}
+
+bool WaylandDataDevice::receiveClipboard(const std::string_view mimeType, const wm::DataChunkCallback &cb, const int sinkFd)
+{
+    return start_receive(m_selection, mimeType, cb, sinkFd, false);
+}
+
+bool WaylandDataDevice::receiveDrop(const std::string_view mimeType, const wm::DataChunkCallback &cb, const int sinkFd)
+{
+    return start_receive(m_dropped, mimeType, cb, sinkFd, true);
+}
+
+bool WaylandDataDevice::start_receive(DataOfferState *state, const std::string_view mimeType, const wm::DataChunkCallback &cb, const int sinkFd, const bool isDrop)
+{
+    if (!state) return false;
+    const auto it = std::find(state->mimeTypes.begin(), state->mimeTypes.end(), mimeType);
+    if (it == state->mimeTypes.end()) return false;
+
+    // A blocking sink would stall the event loop once it fills up, so it is
+    // switched to non-blocking until the transfer finishes.
+    int sinkFlags = -1;
+    if (sinkFd >= 0) {
+        const int flags = fcntl(sinkFd, F_GETFL);
+        if (flags < 0) return false;
+        if (!(flags & O_NONBLOCK)) {
+            if (fcntl(sinkFd, F_SETFL, flags | O_NONBLOCK) != 0) return false;
+            sinkFlags = flags;
+        }
+    }
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+        if (sinkFlags >= 0) fcntl(sinkFd, F_SETFL, sinkFlags);
+        return false;
+    }
+    wl_data_offer_receive(state->offer, it->c_str(), fds[1]);
+    close(fds[1]);
+    // The source only sees the request once it is flushed.
+    wl_display_flush(m_mgr.display());
+
+    (m_inService ? m_deferred : m_transfers).push_back(DataTransfer{
+        .pipeFd = fds[0],
+        .sinkFd = sinkFd,
+        .sinkFlags = sinkFlags,
+        .onChunk = cb,
+        .dropOffer = isDrop ? state : nullptr,
+        .pending = std::pmr::vector<std::byte>(m_resource),
+    });
+    if (isDrop) m_dropped = nullptr;
+    return true;
+}
+
+bool WaylandDataDevice::setClipboard(const std::span<const std::string_view> mimeTypes, const wm::DataProvider &provider, const uint32_t serial)
+{
+    if (!m_device || mimeTypes.empty() || !provider) return false;
+    if (m_source) wl_data_source_destroy(m_source);
+
+    m_source = wl_data_device_manager_create_data_source(m_manager);
+    wl_data_source_add_listener(m_source, &DATA_SOURCE_LISTENER, this);
+    std::pmr::string type(m_resource);
+    for (const auto mime : mimeTypes) {
+        type.assign(mime);
+        wl_data_source_offer(m_source, type.c_str());
+    }
+    m_provider = provider;
+    wl_data_device_set_selection(m_device, m_source, serial);
+    return true;
+}
+
+void WaylandDataDevice::clearClipboard(const uint32_t serial)
+{
+    if (!m_device) return;
+    wl_data_device_set_selection(m_device, nullptr, serial);
+    if (m_source) wl_data_source_destroy(m_source);
+    m_source = nullptr;
+    m_provider = nullptr;
+}
+
+void WaylandDataDevice::start_send(const std::string_view mimeType, const int fd)
+{
+    if (!m_provider || !set_nonblocking(fd)) {
+        close(fd);
+        return;
+    }
+
+    wm::DataPayload payload = m_provider(mimeType);
+    DataTransfer t{.pipeFd = fd, .sending = true, .pending = std::pmr::vector<std::byte>(m_resource)};
+    if (payload.fd >= 0) {
+        struct stat st{};
+        t.fileFd = fcntl(payload.fd, F_DUPFD_CLOEXEC, 0);
+        if (t.fileFd < 0 || fstat(t.fileFd, &st) != 0) {
+            if (t.fileFd >= 0) close(t.fileFd);
+            close(fd);
+            return;
+        }
+        const size_t end = static_cast<size_t>(st.st_size);
+        const size_t start = std::min(payload.offset, end);
+        t.fileOffset = static_cast<off_t>(start);
+        t.remaining = payload.length ? std::min(payload.length, end - start) : end - start;
+    } else if (payload.bytes) {
+        t.remaining = payload.bytes->size() - std::min(payload.offset, payload.bytes->size());
+        t.fileOffset = static_cast<off_t>(payload.bytes->size() - t.remaining);
+        t.bytes = std::move(payload.bytes);
+    }
+
+    (m_inService ? m_deferred : m_transfers).push_back(std::move(t));
+}
+
+void WaylandDataDevice::appendPollFds(std::pmr::vector<pollfd> &fds) const
+{
+    for (const auto &t : m_transfers) {
+        if (t.waitSink) {
+            fds.push_back(pollfd{.fd = t.sinkFd, .events = POLLOUT, .revents = 0});
+        } else {
+            fds.push_back(pollfd{.fd = t.pipeFd, .events = static_cast<short>(t.sending ? POLLOUT : POLLIN), .revents = 0});
+        }
+    }
+}
+
+void WaylandDataDevice::service(const std::span<const pollfd> fds)
+{
+    m_inService = true;
+    const size_t count = std::min(fds.size(), m_transfers.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (!fds[i].revents || m_transfers[i].finished) continue;
+        if (m_transfers[i].sending) {
+            pump_send(m_transfers[i]);
+        } else {
+            pump_receive(m_transfers[i]);
+        }
+    }
+    m_inService = false;
+    std::erase_if(m_transfers, [](const DataTransfer &t) { return t.finished; });
+    for (auto &t : m_deferred) m_transfers.push_back(std::move(t));
+    m_deferred.clear();
+}
+
+bool WaylandDataDevice::pump_receive(DataTransfer &t)
+{
+    t.waitSink = false;
+    // Whatever a full sink refused last time goes out before reading more.
+    if (!t.pending.empty() && !write_pending(t)) return !t.finished;
+
+    for (int pass = 0; pass < CHUNKS_PER_PASS; ++pass) {
+        ssize_t n = -1;
+        if (t.sinkFd >= 0) {
+            n = splice(t.pipeFd, nullptr, t.sinkFd, nullptr, CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n < 0 && errno == EINVAL) {
+                // Sink cannot be spliced into (e.g. opened with O_APPEND); copy instead.
+                n = read(t.pipeFd, m_chunk.data(), m_chunk.size());
+                if (n > 0) {
+                    t.pending.assign(m_chunk.data(), m_chunk.data() + n);
+                    if (!write_pending(t)) return !t.finished;
+                }
+            } else if (n < 0 && errno == EAGAIN && has_input(t.pipeFd)) {
+                // The pipe has data, so it is the sink that is full. Wait for
+                // it to drain rather than spin on a readable pipe.
+                t.waitSink = true;
+                return true;
+            }
+        } else {
+            n = read(t.pipeFd, m_chunk.data(), m_chunk.size());
+            if (n > 0 && t.onChunk) {
+                t.onChunk(std::span<const std::byte>(m_chunk.data(), static_cast<size_t>(n)), wm::TransferStatus::Data);
+            }
+        }
+        if (n == 0) {
+            finish(t, wm::TransferStatus::Done);
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) return true;
+            finish(t, wm::TransferStatus::Failed);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WaylandDataDevice::write_pending(DataTransfer &t)
+{
+    size_t written = 0;
+    while (written < t.pending.size()) {
+        const ssize_t n = write(t.sinkFd, t.pending.data() + written, t.pending.size() - written);
+        if (n > 0) {
+            written += static_cast<size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            t.pending.erase(t.pending.begin(), t.pending.begin() + static_cast<ptrdiff_t>(written));
+            t.waitSink = true;
+            return false;
+        } else {
+            finish(t, wm::TransferStatus::Failed);
+            return false;
+        }
+    }
+    t.pending.clear();
+    return true;
+}
+
+bool WaylandDataDevice::pump_send(DataTransfer &t)
+{
+    // A reader that went away must not kill the process; the write just
+    // fails with EPIPE.
+    const SigpipeGuard sigpipe;
+    for (int pass = 0; pass < CHUNKS_PER_PASS && t.remaining > 0; ++pass) {
+        const size_t want = std::min(t.remaining, CHUNK_SIZE);
+        ssize_t n = -1;
+        if (t.fileFd >= 0) {
+            n = sendfile(t.pipeFd, t.fileFd, &t.fileOffset, want);
+        } else if (t.bytes) {
+            n = write(t.pipeFd, t.bytes->data() + t.fileOffset, want);
+            if (n > 0) t.fileOffset += n;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) return true;
+            finish(t, wm::TransferStatus::Failed);
+            return false;
+        }
+        if (n == 0) break;
+        t.remaining -= static_cast<size_t>(n);
+    }
+    if (t.remaining == 0) {
+        finish(t, wm::TransferStatus::Done);
+        return false;
+    }
+    return true;
+}
+
+void WaylandDataDevice::finish(DataTransfer &t, const wm::TransferStatus status)
+{
+    t.finished = true;
+    if (t.pipeFd >= 0) close(t.pipeFd);
+    t.pipeFd = -1;
+    if (t.fileFd >= 0) close(t.fileFd);
+    t.fileFd = -1;
+    t.bytes.reset();
+    if (t.sinkFlags >= 0) fcntl(t.sinkFd, F_SETFL, t.sinkFlags);
+    t.sinkFlags = -1;
+    if (t.dropOffer) {
+        if (status == wm::TransferStatus::Done && m_version >= 3) wl_data_offer_finish(t.dropOffer->offer);
+        destroy_offer(t.dropOffer);
+    }
+    if (!t.sending && t.onChunk) {
+        const auto cb = std::move(t.onChunk);
+        cb({}, status);
+    }
+}
+
+void WaylandDataDevice::handle_data_offer(void *data, wl_data_device *device, wl_data_offer *offer)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    (void)device;
+    auto *state = std::pmr::polymorphic_allocator<DataOfferState>(self->m_resource).new_object<DataOfferState>(self->m_resource);
+    state->offer = offer;
+    wl_data_offer_add_listener(offer, &DATA_OFFER_LISTENER, state);
+    self->m_newOffers.push_back(state);
+}
+
+static DataOfferState *take_offer(std::pmr::vector<DataOfferState *> &offers, const wl_data_offer *offer)
+{
+    const auto it = std::find_if(offers.begin(), offers.end(), [offer](const DataOfferState *s) { return s->offer == offer; });
+    if (it == offers.end()) return nullptr;
+    DataOfferState *state = *it;
+    offers.erase(it);
+    return state;
+}
+
+void WaylandDataDevice::handle_enter(void *data, wl_data_device *device, const uint32_t serial, wl_surface *surface, const wl_fixed_t x, const wl_fixed_t y, wl_data_offer *offer)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    (void)device;
+    self->destroy_offer(self->m_drag);
+    self->destroy_offer(self->m_dropped);
+    self->m_drag = take_offer(self->m_newOffers, offer);
+    self->m_dragSerial = serial;
+    self->m_dragWindow = surface ? static_cast<WaylandWindow *>(wl_surface_get_user_data(surface)) : nullptr;
+    // The title bar is no drop target; the drag is refused until it moves
+    // onto the content surface, which brings a fresh enter.
+    const bool onTitleBar = self->m_dragWindow && self->m_dragWindow->on_decoration(surface);
+    if (onTitleBar) self->m_dragWindow = nullptr;
+
+    if (self->m_drag) {
+        if (self->m_version >= 3) {
+            wl_data_offer_set_actions(self->m_drag->offer,
+                WL_DATA_DEVICE_MANAGER_DND_ACTION_COPY | WL_DATA_DEVICE_MANAGER_DND_ACTION_MOVE,
+                WL_DATA_DEVICE_MANAGER_DND_ACTION_COPY);
+        }
+        const char *first = self->m_drag->mimeTypes.empty() || onTitleBar ? nullptr : self->m_drag->mimeTypes.front().c_str();
+        wl_data_offer_accept(self->m_drag->offer, serial, first);
+    }
+    if (self->m_dragWindow) {
+        self->m_mgr.queueDropEvent(*self->m_dragWindow, wm::DropEvent{
+            .action = wm::DropAction::Enter,
+            .x = wl_fixed_to_double(x),
+            .y = wl_fixed_to_double(y),
+        });
+    }
+}
+
+void WaylandDataDevice::handle_leave(void *data, wl_data_device *device)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    (void)device;
+    self->destroy_offer(self->m_drag);
+    if (self->m_dragWindow) {
+        self->m_mgr.queueDropEvent(*self->m_dragWindow, wm::DropEvent{.action = wm::DropAction::Leave});
+    }
+    self->m_dragWindow = nullptr;
+}
+
+void WaylandDataDevice::handle_motion(void *data, wl_data_device *device, const uint32_t time, const wl_fixed_t x, const wl_fixed_t y)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    (void)device; (void)time;
+    if (!self->m_dragWindow) return;
+    self->m_mgr.queueDropEvent(*self->m_dragWindow, wm::DropEvent{
+        .action = wm::DropAction::Motion,
+        .x = wl_fixed_to_double(x),
+        .y = wl_fixed_to_double(y),
+    });
+}
+
+void WaylandDataDevice::handle_drop(void *data, wl_data_device *device)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    (void)device;
+    // Keep the offer past the leave that follows; receiveDrop() consumes it.
+    self->destroy_offer(self->m_dropped);
+    self->m_dropped = self->m_drag;
+    self->m_drag = nullptr;
+    if (self->m_dragWindow) {
+        self->m_mgr.queueDropEvent(*self->m_dragWindow, wm::DropEvent{.action = wm::DropAction::Drop});
+    }
+}
+
+void WaylandDataDevice::handle_selection(void *data, wl_data_device *device, wl_data_offer *offer)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    (void)device;
+    self->destroy_offer(self->m_selection);
+    self->m_selection = take_offer(self->m_newOffers, offer);
+}
+
+void WaylandDataDevice::handle_offer_offer(void *data, wl_data_offer *offer, const char *mimeType)
+{
+    auto *state = static_cast<DataOfferState *>(data);
+    (void)offer;
+    state->mimeTypes.emplace_back(mimeType);
+}
+
+void WaylandDataDevice::handle_offer_source_actions(void *data, wl_data_offer *offer, const uint32_t actions)
+{
+    auto *state = static_cast<DataOfferState *>(data);
+    (void)offer;
+    state->sourceActions = actions;
+}
+
+void WaylandDataDevice::handle_offer_action(void *data, wl_data_offer *offer, const uint32_t action)
+{
+    auto *state = static_cast<DataOfferState *>(data);
+    (void)offer;
+    state->action = action;
+}
+
+void WaylandDataDevice::handle_source_target(void *data, wl_data_source *source, const char *mimeType)
+{
+    (void)data; (void)source; (void)mimeType;
+}
+
+void WaylandDataDevice::handle_source_send(void *data, wl_data_source *source, const char *mimeType, const int32_t fd)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    (void)source;
+    self->start_send(mimeType, fd);
+}
+
+void WaylandDataDevice::handle_source_cancelled(void *data, wl_data_source *source)
+{
+    auto *self = static_cast<WaylandDataDevice *>(data);
+    wl_data_source_destroy(source);
+    if (self->m_source == source) {
+        self->m_source = nullptr;
+        self->m_provider = nullptr;
+    }
+}
+
+void WaylandDataDevice::handle_source_dnd_drop_performed(void *data, wl_data_source *source)
+{
+    (void)data; (void)source;
+}
+
+void WaylandDataDevice::handle_source_dnd_finished(void *data, wl_data_source *source)
+{
+    (void)data; (void)source;
+}
+
+void WaylandDataDevice::handle_source_action(void *data, wl_data_source *source, const uint32_t action)
+{
+    (void)data; (void)source; (void)action;
+}
+
+}
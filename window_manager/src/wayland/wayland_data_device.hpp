@@ -0,0 +1,140 @@
+#pragma once
+
+#include <wayland-client.h>
+#include <poll.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "window_manager/window_manager.hpp"
+
+namespace wm::wayland_impl {
+
+class WaylandWindowManager;
+class WaylandWindow;
+
+struct DataOfferState {
+    explicit DataOfferState(std::pmr::memory_resource *resource) : mimeTypes(resource) {}
+
+    wl_data_offer *offer = nullptr;
+    std::pmr::vector<std::pmr::string> mimeTypes;
+    uint32_t sourceActions = 0;
+    uint32_t action = 0;
+};
+
+// One streaming transfer over a pipe. Receives read (or splice) from the
+// pipe until EOF; sends write from memory or sendfile from a file until the
+// payload is exhausted. Never blocks: each pass moves at most a few chunks.
+struct DataTransfer {
+    int pipeFd = -1;
+    bool sending = false;
+    bool finished = false;
+
+    // Receive side.
+    int sinkFd = -1;
+    // Sink's file status flags from before the transfer made it
+    // non-blocking; finish() puts them back. -1 if nothing was changed.
+    int sinkFlags = -1;
+    wm::DataChunkCallback onChunk{};
+    // Drop offer to finish() and destroy once the data is in.
+    DataOfferState *dropOffer = nullptr;
+    // Bytes read for a sink that could not take them all yet.
+    std::pmr::vector<std::byte> pending{};
+    // The sink is full: poll it for POLLOUT instead of the pipe for input.
+    bool waitSink = false;
+
+    // Send side.
+    std::shared_ptr<const std::vector<std::byte>> bytes{};
+    int fileFd = -1;
+    off_t fileOffset = 0;
+    size_t remaining = 0;
+};
+
+class WaylandDataDevice {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr int CHUNKS_PER_PASS = 4;
+
+    WaylandDataDevice(WaylandWindowManager &mgr, wl_data_device_manager *manager, uint32_t version);
+    ~WaylandDataDevice();
+
+    void bindSeat(wl_seat *seat);
+    void forgetWindow(const WaylandWindow *window);
+
+    // Appends one pollfd per active transfer, in transfer order: the pipe,
+    // or the sink while a receive waits for it to drain.
+    void appendPollFds(std::pmr::vector<pollfd> &fds) const;
+    // revents must line up with the fds appended by appendPollFds().
+    void service(std::span<const pollfd> fds);
+
+    std::span<const std::pmr::string> clipboardMimeTypes() const;
+    bool receiveClipboard(std::string_view mimeType, const wm::DataChunkCallback &cb, int sinkFd);
+    bool setClipboard(std::span<const std::string_view> mimeTypes, const wm::DataProvider &provider, uint32_t serial);
+    void clearClipboard(uint32_t serial);
+
+    std::span<const std::pmr::string> dropMimeTypes() const;
+    void acceptDrop(std::string_view mimeType);
+    bool receiveDrop(std::string_view mimeType, const wm::DataChunkCallback &cb, int sinkFd);
+
+    static void handle_data_offer(void *data, wl_data_device *device, wl_data_offer *offer);
+    static void handle_enter(void *data, wl_data_device *device, uint32_t serial, wl_surface *surface, wl_fixed_t x, wl_fixed_t y, wl_data_offer *offer);
+    static void handle_leave(void *data, wl_data_device *device);
+    static void handle_motion(void *data, wl_data_device *device, uint32_t time, wl_fixed_t x, wl_fixed_t y);
+    static void handle_drop(void *data, wl_data_device *device);
+    static void handle_selection(void *data, wl_data_device *device, wl_data_offer *offer);
+
+    static void handle_offer_offer(void *data, wl_data_offer *offer, const char *mimeType);
+    static void handle_offer_source_actions(void *data, wl_data_offer *offer, uint32_t actions);
+    static void handle_offer_action(void *data, wl_data_offer *offer, uint32_t action);
+
+    static void handle_source_target(void *data, wl_data_source *source, const char *mimeType);
+    static void handle_source_send(void *data, wl_data_source *source, const char *mimeType, int32_t fd);
+    static void handle_source_cancelled(void *data, wl_data_source *source);
+    static void handle_source_dnd_drop_performed(void *data, wl_data_source *source);
+    static void handle_source_dnd_finished(void *data, wl_data_source *source);
+    static void handle_source_action(void *data, wl_data_source *source, uint32_t action);
+
+private:
+    void destroy_offer(DataOfferState *&state);
+    bool start_receive(DataOfferState *state, std::string_view mimeType, const wm::DataChunkCallback &cb, int sinkFd, bool isDrop);
+    void start_send(std::string_view mimeType, int fd);
+    bool pump_receive(DataTransfer &t);
+    // Writes t.pending to the sink; false unless all of it went out.
+    bool write_pending(DataTransfer &t);
+    bool pump_send(DataTransfer &t);
+    void finish(DataTransfer &t, wm::TransferStatus status);
+
+    WaylandWindowManager &m_mgr;
+    std::pmr::memory_resource *m_resource = nullptr;
+    wl_data_device_manager *m_manager = nullptr;
+    uint32_t m_version = 0;
+    wl_data_device *m_device = nullptr;
+
+    // Offers announced by data_offer that are not yet a selection or drag.
+    std::pmr::vector<DataOfferState *> m_newOffers;
+    DataOfferState *m_selection = nullptr;
+    DataOfferState *m_drag = nullptr;
+    // Dropped offer kept alive until its data has been received.
+    DataOfferState *m_dropped = nullptr;
+    WaylandWindow *m_dragWindow = nullptr;
+    uint32_t m_dragSerial = 0;
+
+    wl_data_source *m_source = nullptr;
+    wm::DataProvider m_provider{};
+
+    std::pmr::vector<DataTransfer> m_transfers;
+    // Transfers started from inside service() (e.g. by a chunk callback);
+    // merged afterwards so references into m_transfers stay valid.
+    std::pmr::vector<DataTransfer> m_deferred;
+    bool m_inService = false;
+    std::pmr::vector<std::byte> m_chunk;
+};
+
+}
@@ -0,0 +1,115 @@
+#include "wayland_decoration.hpp"
+
+namespace wm::wayland_impl {
+
+static constexpr uint32_t TITLEBAR_FOCUSED = 0xFF2B2B2B;
+static constexpr uint32_t TITLEBAR_UNFOCUSED = 0xFF4A4A4A;
+static constexpr uint32_t TITLEBAR_SEPARATOR = 0xFF1A1A1A;
+static constexpr uint32_t CLOSE_GLYPH = 0xFFE6E6E6;
+static constexpr int CLOSE_INSET = 8;
+
+static constexpr wl_buffer_listener DECORATION_BUFFER_LISTENER = {
+    .release = WaylandDecoration::handle_buffer_release,
+};
+
+WaylandDecoration::WaylandDecoration(WaylandWindowManager &mgr, WaylandWindow &window)
+    : m_mgr(mgr), m_parentSurface(window.surface()), m_width(window.getWidth())
+{
+    if (!mgr.subcompositor()) return;
+    m_surface = wl_compositor_create_surface(mgr.compositor());
+    // Pointer focus maps the bar back to its window like any other surface.
+    wl_surface_set_user_data(m_surface, &window);
+    m_subsurface = wl_subcompositor_get_subsurface(mgr.subcompositor(), m_surface, window.surface());
+    wl_subsurface_set_position(m_subsurface, 0, -TITLEBAR_HEIGHT);
+    // Synchronized (the default): bar and content change in the same frame.
+    wl_subsurface_place_above(m_subsurface, window.surface());
+}
+
+WaylandDecoration::~WaylandDecoration()
+{
+    m_mgr.forgetSurface(m_surface);
+    if (m_subsurface) wl_subsurface_destroy(m_subsurface);
+    if (m_surface) wl_surface_destroy(m_surface);
+    for (auto &b : m_buffers) release_shm_buffer(b.shm);
+}
+
+void WaylandDecoration::setWidth(const int width)
+{
+    if (width == m_width) return;
+    m_width = width;
+    m_dirty = true;
+}
+
+void WaylandDecoration::setFocused(const bool focused)
+{
+    if (focused == m_focused) return;
+    m_focused = focused;
+    m_dirty = true;
+}
+
+WaylandDecoration::Buffer *WaylandDecoration::acquire_buffer()
+{
+    for (auto &b : m_buffers) {
+        if (b.busy) continue;
+        if (b.shm.buffer && b.shm.width == m_width) return &b;
+        if (!create_shm_buffer(m_mgr.shm(), m_width, TITLEBAR_HEIGHT, WL_SHM_FORMAT_ARGB8888, b.shm)) return nullptr;
+        wl_buffer_add_listener(b.shm.buffer, &DECORATION_BUFFER_LISTENER, &b);
+        return &b;
+    }
+    return nullptr;
+}
+
+bool WaylandDecoration::update()
+{
+    if (!m_dirty || !m_surface || m_width <= 0) return false;
+    // Both buffers held by the compositor: stay dirty and retry next time.
+    Buffer *buffer = acquire_buffer();
+    if (!buffer) return false;
+
+    render(*buffer);
+    wl_surface_attach(m_surface, buffer->shm.buffer, 0, 0);
+    wl_surface_damage(m_surface, 0, 0, m_width, TITLEBAR_HEIGHT);
+    m_mgr.requestCommit(m_surface, m_parentSurface);
+    buffer->busy = true;
+    m_dirty = false;
+    return true;
+}
+
+void WaylandDecoration::render(Buffer &buffer) const
+{
+    auto *pixels = static_cast<uint32_t *>(buffer.shm.data.get());
+    const int stride = buffer.shm.stride / 4;
+    const uint32_t background = m_focused ? TITLEBAR_FOCUSED : TITLEBAR_UNFOCUSED;
+
+    for (int y = 0; y < TITLEBAR_HEIGHT; ++y) {
+        const uint32_t color = y == TITLEBAR_HEIGHT - 1 ? TITLEBAR_SEPARATOR : background;
+        uint32_t *row = pixels + y * stride;
+        for (int x = 0; x < m_width; ++x) row[x] = color;
+    }
+
+    // Close button: an X in the rightmost square of the bar.
+    const int left = m_width - TITLEBAR_HEIGHT + CLOSE_INSET;
+    const int size = TITLEBAR_HEIGHT - 2 * CLOSE_INSET;
+    if (left < 0) return;
+    for (int i = 0; i < size; ++i) {
+        const int y = CLOSE_INSET + i;
+        pixels[y * stride + left + i] = CLOSE_GLYPH;
+        pixels[y * stride + left + size - 1 - i] = CLOSE_GLYPH;
+    }
+}
+
+WaylandDecoration::Hit WaylandDecoration::hitTest(const double x, const double y) const
+{
+    if (y < 0 || y >= TITLEBAR_HEIGHT || x < 0 || x >= m_width) return Hit::None;
+    if (x >= m_width - TITLEBAR_HEIGHT) return Hit::Close;
+    return Hit::Title;
+}
+
+void WaylandDecoration::handle_buffer_release(void *data, wl_buffer *buffer)
+{
+    auto *self = static_cast<Buffer *>(data);
+    (void)buffer;
+    self->busy = false;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <wayland-client.h>
+
+#include <array>
+#include <cstdint>
+
+#include "window_manager/wayland/wayland_window_manager.hpp"
+
+namespace wm::wayland_impl {
+
+// Client-side title bar used when the compositor will not decorate the
+// window. It is a synchronized subsurface above the content with its own
+// buffers: it is drawn only when its width or focus state changes, and
+// otherwise rides along with the parent's commits untouched.
+class WaylandDecoration {
+public:
+    static constexpr int TITLEBAR_HEIGHT = 24;
+
+    enum class Hit {
+        None,
+        Title,
+        Close,
+    };
+
+    WaylandDecoration(WaylandWindowManager &mgr, WaylandWindow &window);
+    ~WaylandDecoration();
+    WaylandDecoration(const WaylandDecoration &) = delete;
+    WaylandDecoration &operator=(const WaylandDecoration &) = delete;
+
+    void setWidth(int width);
+    void setFocused(bool focused);
+    // Redraws and commits if something changed since the last call; true
+    // if it did. The result shows with the parent surface's next commit.
+    bool update();
+
+    wl_surface *surface() const { return m_surface; }
+    Hit hitTest(double x, double y) const;
+
+    static void handle_buffer_release(void *data, wl_buffer *buffer);
+
+private:
+    struct Buffer {
+        ShmBuffer shm{};
+        bool busy = false;
+    };
+
+    Buffer *acquire_buffer();
+    void render(Buffer &buffer) const;
+
+    WaylandWindowManager &m_mgr;
+    wl_surface *m_surface = nullptr;
+    wl_subsurface *m_subsurface = nullptr;
+    wl_surface *m_parentSurface = nullptr;
+    // Two buffers so a redraw never writes into one the compositor holds.
+    std::array<Buffer, 2> m_buffers{};
+    int m_width = 0;
+    bool m_focused = false;
+    bool m_dirty = true;
+};
+
+}
@@ -0,0 +1,144 @@
+#include "window_manager/wayland/wayland_window_manager.hpp"
+#include <wayland-client.h>
+#include <relative-pointer-unstable-v1-client-protocol.h>
+#include <pointer-constraints-unstable-v1-client-protocol.h>
+
+namespace wm::wayland_impl {
+
+static constexpr zwp_relative_pointer_v1_listener RELATIVE_POINTER_LISTENER = {
+    .relative_motion = WaylandWindowManager::handle_relative_motion,
+};
+
+static constexpr zwp_locked_pointer_v1_listener LOCKED_POINTER_LISTENER = {
+    .locked = WaylandWindow::handle_locked,
+    .unlocked = WaylandWindow::handle_unlocked,
+};
+
+static constexpr zwp_confined_pointer_v1_listener CONFINED_POINTER_LISTENER = {
+    .confined = WaylandWindow::handle_confined,
+    .unconfined = WaylandWindow::handle_unconfined,
+};
+
+void WaylandWindowManager::setup_relative_pointer()
+{
+    if (m_relativePointer && !m_pointer) {
+        zwp_relative_pointer_v1_destroy(m_relativePointer);
+        m_relativePointer = nullptr;
+    } else if (!m_relativePointer && m_pointer && m_relativePointerManager) {
+        m_relativePointer = zwp_relative_pointer_manager_v1_get_relative_pointer(m_relativePointerManager, m_pointer);
+        zwp_relative_pointer_v1_add_listener(m_relativePointer, &RELATIVE_POINTER_LISTENER, this);
+    }
+}
+
+void WaylandWindowManager::apply_constraints()
+{
+    for (auto &weak_win : m_windows) {
+        if (auto win = weak_win.lock()) {
+            if (m_pointer) win->apply_constraint();
+            else win->release_constraint();
+        }
+    }
+}
+
+void WaylandWindowManager::flush_relative_motion()
+{
+    if (m_relativeWindow && m_relative.eventCount > 0) {
+        m_pending.push_back(PendingEvent{.window = m_relativeWindow, .payload = m_relative});
+    }
+    m_relative = wm::RelativeMotion{};
+    m_relativeWindow = nullptr;
+}
+
+void WaylandWindowManager::handle_relative_motion(void *data, zwp_relative_pointer_v1 *pointer, const uint32_t utime_hi, const uint32_t utime_lo, const wl_fixed_t dx, const wl_fixed_t dy, const wl_fixed_t dx_unaccel, const wl_fixed_t dy_unaccel)
+{
+    auto *self = static_cast<WaylandWindowManager *>(data);
+    (void)pointer;
+    if (!self->m_pointerFocus) return;
+    if (self->m_relativeWindow != self->m_pointerFocus) {
+        self->flush_relative_motion();
+        self->m_relativeWindow = self->m_pointerFocus;
+    }
+
+    // Summed as raw wl_fixed values; converting happens once, in the reader.
+    wm::RelativeMotion &rel = self->m_relative;
+    rel.dx += dx;
+    rel.dy += dy;
+    rel.dxUnaccel += dx_unaccel;
+    rel.dyUnaccel += dy_unaccel;
+    rel.timeUs = (static_cast<uint64_t>(utime_hi) << 32) | utime_lo;
+    ++rel.eventCount;
+}
+
+bool WaylandWindow::setPointerConstraint(const wm::PointerConstraint constraint)
+{
+    if (constraint != wm::PointerConstraint::None && !m_mgr.pointerConstraints()) return false;
+    if (constraint == m_constraint) return true;
+    release_constraint();
+    m_constraint = constraint;
+    apply_constraint();
+    return true;
+}
+
+void WaylandWindow::apply_constraint()
+{
+    zwp_pointer_constraints_v1 *constraints = m_mgr.pointerConstraints();
+    wl_pointer *pointer = m_mgr.pointer();
+    if (!constraints || !pointer || !m_surface || m_lockedPointer || m_confinedPointer) return;
+
+    // Persistent: the compositor re-activates it each time the window
+    // regains pointer focus, without another request from us.
+    const uint32_t lifetime = ZWP_POINTER_CONSTRAINTS_V1_LIFETIME_PERSISTENT;
+    if (m_constraint == wm::PointerConstraint::Lock) {
+        m_lockedPointer = zwp_pointer_constraints_v1_lock_pointer(constraints, m_surface, pointer, nullptr, lifetime);
+        zwp_locked_pointer_v1_add_listener(m_lockedPointer, &LOCKED_POINTER_LISTENER, this);
+    } else if (m_constraint == wm::PointerConstraint::Confine) {
+        m_confinedPointer = zwp_pointer_constraints_v1_confine_pointer(constraints, m_surface, pointer, nullptr, lifetime);
+        zwp_confined_pointer_v1_add_listener(m_confinedPointer, &CONFINED_POINTER_LISTENER, this);
+    }
+}
+
+void WaylandWindow::release_constraint()
+{
+    if (m_lockedPointer) zwp_locked_pointer_v1_destroy(m_lockedPointer);
+    if (m_confinedPointer) zwp_confined_pointer_v1_destroy(m_confinedPointer);
+    m_lockedPointer = nullptr;
+    m_confinedPointer = nullptr;
+    if (m_constraintActive) {
+        m_constraintActive = false;
+        m_mgr.queueEvent(*this, wm::WmEvent::PointerConstraintDeactivated);
+    }
+}
+
+void WaylandWindow::handle_locked(void *data, zwp_locked_pointer_v1 *locked)
+{
+    auto *self = static_cast<WaylandWindow *>(data);
+    (void)locked;
+    self->m_constraintActive = true;
+    self->m_mgr.queueEvent(*self, wm::WmEvent::PointerConstraintActivated);
+}
+
+void WaylandWindow::handle_unlocked(void *data, zwp_locked_pointer_v1 *locked)
+{
+    auto *self = static_cast<WaylandWindow *>(data);
+    (void)locked;
+    self->m_constraintActive = false;
+    self->m_mgr.queueEvent(*self, wm::WmEvent::PointerConstraintDeactivated);
+}
+
+void WaylandWindow::handle_confined(void *data, zwp_confined_pointer_v1 *confined)
+{
+    auto *self = static_cast<WaylandWindow *>(data);
+    (void)confined;
+    self->m_constraintActive = true;
+    self->m_mgr.queueEvent(*self, wm::WmEvent::PointerConstraintActivated);
+}
+
+void WaylandWindow::handle_unconfined(void *data, zwp_confined_pointer_v1 *confined)
+{
+    auto *self = static_cast<WaylandWindow *>(data);
+    (void)confined;
+    self->m_constraintActive = false;
+    self->m_mgr.queueEvent(*self, wm::WmEvent::PointerConstraintDeactivated);
+}
+
+}
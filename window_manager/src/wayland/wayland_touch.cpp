@@ -0,0 +1,227 @@
+#include "wayland_touch.hpp"
+#include "window_manager/wayland/wayland_window_manager.hpp"
+
+namespace wm::wayland_impl {
+
+static constexpr wl_touch_listener TOUCH_LISTENER = {
+    .down = WaylandTouch::handle_down,
+    .up = WaylandTouch::handle_up,
+    .motion = WaylandTouch::handle_motion,
+    .frame = WaylandTouch::handle_frame,
+    .cancel = WaylandTouch::handle_cancel,
+    .shape = WaylandTouch::handle_shape,
+    .orientation = WaylandTouch::handle_orientation,
+};
+
+WaylandTouch::WaylandTouch(WaylandWindowManager &mgr, wl_touch *touch, std::pmr::memory_resource *resource)
+    : m_mgr(mgr), m_touch(touch),
+      m_ids(ARENA_CAPACITY, resource), m_x(ARENA_CAPACITY, resource), m_y(ARENA_CAPACITY, resource),
+      m_states(ARENA_CAPACITY, resource), m_times(ARENA_CAPACITY, resource)
+{
+    wl_touch_add_listener(m_touch, &TOUCH_LISTENER, this);
+}
+
+WaylandTouch::~WaylandTouch()
+{
+    if (wl_touch_get_version(m_touch) >= WL_TOUCH_RELEASE_SINCE_VERSION) wl_touch_release(m_touch);
+    else wl_touch_destroy(m_touch);
+}
+
+void WaylandTouch::forgetWindow(const WaylandWindow *window)
+{
+    // Their ends will never be queued, so their reserved slots go back.
+    for (size_t i = 0; i < m_contactCount;) {
+        if (m_contacts[i].window != window) {
+            ++i;
+            continue;
+        }
+        if (m_contacts[i].reported) --m_reported;
+        m_contacts[i] = m_contacts[--m_contactCount];
+    }
+    for (size_t i = 0; i < m_frameCount; ++i) {
+        Entry &e = m_frame[i];
+        if (e.window != window) continue;
+        const bool ends = e.state == wm::TouchState::Up || e.state == wm::TouchState::Cancel;
+        if (ends && e.reported) --m_reported;
+        e.window = nullptr;
+    }
+}
+
+WaylandTouch::Contact *WaylandTouch::find_contact(const int32_t id)
+{
+    for (size_t i = 0; i < m_contactCount; ++i) {
+        if (m_contacts[i].id == id) return &m_contacts[i];
+    }
+    return nullptr;
+}
+
+bool WaylandTouch::record(const Contact &contact, const wm::TouchState state, const uint32_t time)
+{
+    // Motion folds into the contact's pending down/motion entry.
+    if (state == wm::TouchState::Motion) {
+        for (size_t i = 0; i < m_frameCount; ++i) {
+            Entry &e = m_frame[i];
+            if (e.id == contact.id && e.window == contact.window && e.state != wm::TouchState::Up) {
+                e.x = contact.x;
+                e.y = contact.y;
+                e.time = time;
+                return true;
+            }
+        }
+    }
+    // contact is already counted in m_contactCount. Keeping
+    // m_frameCount + m_contactCount within the buffer leaves every live
+    // contact a slot for the Up or Cancel that ends it.
+    const bool ends = state == wm::TouchState::Up || state == wm::TouchState::Cancel;
+    if (!ends && m_frameCount + m_contactCount >= m_frame.size()) return false;
+    m_frame[m_frameCount++] = Entry{
+        .window = contact.window,
+        .id = contact.id,
+        .x = contact.x,
+        .y = contact.y,
+        .state = state,
+        .time = time,
+        .reported = contact.reported,
+    };
+    return true;
+}
+
+bool WaylandTouch::admit(const size_t index)
+{
+    const Entry &e = m_frame[index];
+    switch (e.state) {
+        case wm::TouchState::Up:
+        case wm::TouchState::Cancel:
+            // Takes the slot reserved when its Down was admitted. The
+            // application never saw a contact whose Down was dropped.
+            if (!e.reported) return false;
+            --m_reported;
+            return true;
+        case wm::TouchState::Motion:
+            return e.reported && m_arenaUsed + m_reported < ARENA_CAPACITY;
+        case wm::TouchState::Down:
+            // The Down itself plus the reserve for its end.
+            if (m_arenaUsed + m_reported + 2 > ARENA_CAPACITY) return false;
+            ++m_reported;
+            mark_reported(index);
+            return true;
+    }
+    return false;
+}
+
+void WaylandTouch::mark_reported(const size_t index)
+{
+    const int32_t id = m_frame[index].id;
+    for (size_t j = index + 1; j < m_frameCount; ++j) {
+        Entry &e = m_frame[j];
+        if (e.id != id) continue;
+        e.reported = true;
+        // A later Down with this id is a new contact.
+        if (e.state == wm::TouchState::Up || e.state == wm::TouchState::Cancel) return;
+    }
+    if (Contact *c = find_contact(id)) c->reported = true;
+}
+
+void WaylandTouch::flush_frame()
+{
+    // One TouchFrame per window, each a contiguous run of the arena.
+    for (size_t i = 0; i < m_frameCount; ++i) {
+        WaylandWindow *window = m_frame[i].window;
+        if (!window) continue;
+
+        const size_t start = m_arenaUsed;
+        for (size_t j = i; j < m_frameCount; ++j) {
+            Entry &e = m_frame[j];
+            if (e.window != window) continue;
+            e.window = nullptr;
+            if (!admit(j)) continue;
+            m_ids[m_arenaUsed] = e.id;
+            m_x[m_arenaUsed] = e.x;
+            m_y[m_arenaUsed] = e.y;
+            m_states[m_arenaUsed] = e.state;
+            m_times[m_arenaUsed] = e.time;
+            ++m_arenaUsed;
+        }
+        const size_t count = m_arenaUsed - start;
+        if (count == 0) continue;
+
+        m_mgr.queueTouchFrame(*window, wm::TouchFrame{
+            .ids = std::span<const int32_t>(m_ids).subspan(start, count),
+            .x = std::span<const double>(m_x).subspan(start, count),
+            .y = std::span<const double>(m_y).subspan(start, count),
+            .states = std::span<const wm::TouchState>(m_states).subspan(start, count),
+            .times = std::span<const uint32_t>(m_times).subspan(start, count),
+        });
+    }
+    m_frameCount = 0;
+}
+
+void WaylandTouch::handle_down(void *data, wl_touch *touch, const uint32_t serial, const uint32_t time, wl_surface *surface, const int32_t id, const wl_fixed_t x, const wl_fixed_t y)
+{
+    auto *self = static_cast<WaylandTouch *>(data);
+    (void)touch;
+    self->m_mgr.noteInputSerial(serial);
+    auto *win = surface ? static_cast<WaylandWindow *>(wl_surface_get_user_data(surface)) : nullptr;
+    // The title bar is not content: its coordinates would read as content
+    // coordinates, so its touches are not reported at all.
+    if (win && win->on_decoration(surface)) return;
+    if (!win || self->m_contactCount == MAX_CONTACTS || self->find_contact(id)) return;
+
+    Contact &c = self->m_contacts[self->m_contactCount++];
+    c = Contact{.window = win, .id = id, .x = wl_fixed_to_double(x), .y = wl_fixed_to_double(y)};
+    // A down that does not fit is ignored like any contact past the limit.
+    if (!self->record(c, wm::TouchState::Down, time)) --self->m_contactCount;
+}
+
+void WaylandTouch::handle_up(void *data, wl_touch *touch, const uint32_t serial, const uint32_t time, const int32_t id)
+{
+    auto *self = static_cast<WaylandTouch *>(data);
+    (void)touch; (void)serial;
+    Contact *c = self->find_contact(id);
+    if (!c) return;
+    // wl_touch.up carries no position; report the last one seen.
+    self->record(*c, wm::TouchState::Up, time);
+    *c = self->m_contacts[--self->m_contactCount];
+}
+
+void WaylandTouch::handle_motion(void *data, wl_touch *touch, const uint32_t time, const int32_t id, const wl_fixed_t x, const wl_fixed_t y)
+{
+    auto *self = static_cast<WaylandTouch *>(data);
+    (void)touch;
+    Contact *c = self->find_contact(id);
+    if (!c) return;
+    c->x = wl_fixed_to_double(x);
+    c->y = wl_fixed_to_double(y);
+    self->record(*c, wm::TouchState::Motion, time);
+}
+
+void WaylandTouch::handle_frame(void *data, wl_touch *touch)
+{
+    auto *self = static_cast<WaylandTouch *>(data);
+    (void)touch;
+    self->flush_frame();
+}
+
+void WaylandTouch::handle_cancel(void *data, wl_touch *touch)
+{
+    auto *self = static_cast<WaylandTouch *>(data);
+    (void)touch;
+    // The compositor took over the sequence; no frame event follows.
+    for (size_t i = 0; i < self->m_contactCount; ++i) {
+        self->record(self->m_contacts[i], wm::TouchState::Cancel, 0);
+    }
+    self->m_contactCount = 0;
+    self->flush_frame();
+}
+
+void WaylandTouch::handle_shape(void *data, wl_touch *touch, const int32_t id, const wl_fixed_t major, const wl_fixed_t minor)
+{
+    (void)data; (void)touch; (void)id; (void)major; (void)minor;
+}
+
+void WaylandTouch::handle_orientation(void *data, wl_touch *touch, const int32_t id, const wl_fixed_t orientation)
+{
+    (void)data; (void)touch; (void)id; (void)orientation;
+}
+
+}
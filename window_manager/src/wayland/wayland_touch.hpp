@@ -0,0 +1,98 @@
+#pragma once
+
+#include <wayland-client.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "window_manager/window_manager.hpp"
+
+namespace wm::wayland_impl {
+
+class WaylandWindowManager;
+class WaylandWindow;
+
+// Collects wl_touch down/motion/up until wl_touch.frame and queues one
+// wm::TouchFrame per window touched in that frame. The arrays behind those
+// frames are sized once up front; nothing is allocated per event.
+class WaylandTouch {
+public:
+    // Simultaneous contacts tracked; further touches are ignored.
+    static constexpr size_t MAX_CONTACTS = 16;
+    // Entries of one wl_touch.frame. A slot per live contact is held back
+    // for its Up or Cancel, so only new downs and motion are ever dropped.
+    static constexpr size_t MAX_FRAME_ENTRIES = MAX_CONTACTS * 3;
+    // Entries held by frames queued but not yet dispatched. A slot per
+    // reported contact stays reserved for its Up or Cancel, so a stalled
+    // application loses new downs and motion, never the end of a contact.
+    static constexpr size_t ARENA_CAPACITY = 1024;
+
+    WaylandTouch(WaylandWindowManager &mgr, wl_touch *touch, std::pmr::memory_resource *resource);
+    ~WaylandTouch();
+
+    void forgetWindow(const WaylandWindow *window);
+    // Called once every queued frame has been delivered.
+    void resetArena() { m_arenaUsed = 0; }
+
+    static void handle_down(void *data, wl_touch *touch, uint32_t serial, uint32_t time, wl_surface *surface, int32_t id, wl_fixed_t x, wl_fixed_t y);
+    static void handle_up(void *data, wl_touch *touch, uint32_t serial, uint32_t time, int32_t id);
+    static void handle_motion(void *data, wl_touch *touch, uint32_t time, int32_t id, wl_fixed_t x, wl_fixed_t y);
+    static void handle_frame(void *data, wl_touch *touch);
+    static void handle_cancel(void *data, wl_touch *touch);
+    static void handle_shape(void *data, wl_touch *touch, int32_t id, wl_fixed_t major, wl_fixed_t minor);
+    static void handle_orientation(void *data, wl_touch *touch, int32_t id, wl_fixed_t orientation);
+
+private:
+    struct Contact {
+        WaylandWindow *window = nullptr;
+        int32_t id = 0;
+        double x = 0.0;
+        double y = 0.0;
+        // Its Down made it into a queued frame.
+        bool reported = false;
+    };
+    struct Entry {
+        WaylandWindow *window = nullptr;
+        int32_t id = 0;
+        double x = 0.0;
+        double y = 0.0;
+        wm::TouchState state = wm::TouchState::Down;
+        uint32_t time = 0;
+        // Copied from the contact; set by flush_frame() for entries that
+        // follow a Down admitted in the same frame.
+        bool reported = false;
+    };
+
+    Contact *find_contact(int32_t id);
+    // False if a Down or Motion entry did not fit; Up and Cancel always do.
+    bool record(const Contact &contact, wm::TouchState state, uint32_t time);
+    void flush_frame();
+    // Whether m_frame[index] goes into the arena; keeps the end-state
+    // reserve balanced.
+    bool admit(size_t index);
+    void mark_reported(size_t index);
+
+    WaylandWindowManager &m_mgr;
+    wl_touch *m_touch = nullptr;
+
+    std::array<Contact, MAX_CONTACTS> m_contacts{};
+    size_t m_contactCount = 0;
+    std::array<Entry, MAX_FRAME_ENTRIES> m_frame{};
+    size_t m_frameCount = 0;
+
+    // Structure-of-arrays storage the queued TouchFrame spans point into.
+    std::pmr::vector<int32_t> m_ids;
+    std::pmr::vector<double> m_x;
+    std::pmr::vector<double> m_y;
+    std::pmr::vector<wm::TouchState> m_states;
+    std::pmr::vector<uint32_t> m_times;
+    size_t m_arenaUsed = 0;
+    // Contacts the application saw go down and not yet end; as many arena
+    // slots are kept free for their Up or Cancel.
+    size_t m_reported = 0;
+};
+
+}
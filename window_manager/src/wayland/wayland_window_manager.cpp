@@ -1,4 +1,9 @@
-#include "wayland_window_manager.hpp"
+#include "window_manager/wayland/wayland_window_manager.hpp"
+#include "wayland_data_device.hpp"
+#include "wayland_cursor.hpp"
+#include "wayland_touch.hpp"
+#include "wayland_decoration.hpp"
+#include "../capture/frame_capture.hpp"
 #include <wayland-client.h>
 #if __has_include(<xdg-shell-client-protocol.h>)
 #include <xdg-shell-client-protocol.h>
@@ -25,10 +30,19 @@ int xdg_toplevel_add_listener(xdg_toplevel*, const xdg_toplevel_listener*, void*
 void xdg_toplevel_destroy(xdg_toplevel*);
 void xdg_toplevel_set_title(xdg_toplevel*, const char*);
 void xdg_toplevel_set_app_id(xdg_toplevel*, const char*);
+void xdg_toplevel_move(xdg_toplevel*, wl_seat*, uint32_t);
+void xdg_surface_set_window_geometry(xdg_surface*, int32_t, int32_t, int32_t, int32_t);
 }
 #endif
-#include <sys/select.h>
+#ifdef WM_HAVE_CURSOR_SHAPE
+#include <cursor-shape-v1-client-protocol.h>
+#endif
+#include <relative-pointer-unstable-v1-client-protocol.h>
+#include <pointer-constraints-unstable-v1-client-protocol.h>
+#include <xdg-decoration-unstable-v1-client-protocol.h>
+#include <poll.h>
 #include <linux/input-event-codes.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -52,8 +66,13 @@ static constexpr wl_registry_listener REGISTRY_LISTENER = {
     .global_remove = WaylandWindowManager::handle_global_remove,
 };
 
-WaylandWindowManager::WaylandWindowManager()
+WaylandWindowManager::WaylandWindowManager(std::pmr::memory_resource *resource)
+    : m_resource(resource), m_windows(resource), m_pool(resource), m_pending(resource), m_dispatching(resource), m_pollFds(resource), m_batchCommits(resource)
 {
+    m_pending.reserve(64);
+    m_dispatching.reserve(64);
+    m_pollFds.reserve(8);
+    m_batchCommits.reserve(16);
     m_display = wl_display_connect(nullptr);
     if (!m_display) {
         std::fprintf(stderr, "[WM] Failed to connect to Wayland display\n");
@@ -71,24 +90,49 @@ WaylandWindowManager::WaylandWindowManager()
 
 WaylandWindowManager::~WaylandWindowManager()
 {
+    // Handles the application still holds must not reach back into this
+    // manager or the display once they are released.
+    for (auto &weak_win : m_windows) {
+        if (auto win = weak_win.lock()) win->detach();
+    }
+    stopCapture();
+    m_poolLimit = 0;
+    for (WaylandWindow *window : m_pool) destroy_window(window);
+    m_pool.clear();
+    m_dataDevice.reset();
+    setup_pointer(false);
+    setup_touch(false);
+    if (m_pointerConstraints) zwp_pointer_constraints_v1_destroy(m_pointerConstraints);
+    if (m_relativePointerManager) zwp_relative_pointer_manager_v1_destroy(m_relativePointerManager);
+    if (m_decorationManager) zxdg_decoration_manager_v1_destroy(m_decorationManager);
+#ifdef WM_HAVE_CURSOR_SHAPE
+    if (m_cursorShapeManager) wp_cursor_shape_manager_v1_destroy(m_cursorShapeManager);
+#endif
+    if (m_subcompositor) wl_subcompositor_destroy(m_subcompositor);
     if (m_display) {
         wl_display_disconnect(m_display);
         m_display = nullptr;
     }
 }
 
-std::unique_ptr<wm::WindowManager> WaylandWindowManager::create()
+std::unique_ptr<wm::WindowManager> WaylandWindowManager::create(std::pmr::memory_resource *resource)
+{
+    return createNative(resource);
+}
+
+std::unique_ptr<WaylandWindowManager> WaylandWindowManager::createNative(std::pmr::memory_resource *resource)
 {
-    auto mgr = std::make_unique<WaylandWindowManager>();
+    auto mgr = std::make_unique<WaylandWindowManager>(resource);
     if (!mgr->m_display || !mgr->m_compositor || !mgr->m_shm || !mgr->m_xdg_wm_base) {
         return nullptr;
     }
-    return std::unique_ptr<wm::WindowManager>(mgr.release());
+    return mgr;
 }
 
-std::vector<std::string> WaylandWindowManager::getVulkanInstanceExtensions() const
+std::span<const char *const> WaylandWindowManager::getVulkanInstanceExtensions() const
 {
-    return {"VK_KHR_surface", "VK_KHR_wayland_surface"};
+    static constexpr const char *EXTENSIONS[] = {"VK_KHR_surface", "VK_KHR_wayland_surface"};
+    return EXTENSIONS;
 }
 
 VkResult WaylandWindowManager::createVulkanWindowSurface(
@@ -98,14 +142,24 @@ VkResult WaylandWindowManager::createVulkanWindowSurface(
     VkSurfaceKHR *surface
 ) const
 {
-#ifdef WM_USE_VULKAN
     // Downcast to access Wayland-native handles
     auto *wlWin = dynamic_cast<WaylandWindow *>(&window);
     if (!wlWin) {
         return (VkResult)(-1);
     }
+    return createVulkanSurface(instance, *wlWin, allocator, surface);
+}
+
+VkResult WaylandWindowManager::createVulkanSurface(
+    VkInstance instance,
+    WaylandWindow &window,
+    const VkAllocationCallbacks *allocator,
+    VkSurfaceKHR *surface
+) const
+{
+#ifdef WM_USE_VULKAN
     wl_display *wlDisplay = m_display;
-    wl_surface *wlSurface = wlWin->m_surface; // friend access
+    wl_surface *wlSurface = window.m_surface; // friend access
     if (!wlDisplay || !wlSurface) {
         return (VkResult)(-1);
     }
@@ -117,35 +171,100 @@ VkResult WaylandWindowManager::createVulkanWindowSurface(
     createInfo.display = wlDisplay;
     createInfo.surface = wlSurface;
 
-    auto fpCreateWaylandSurfaceKHR = reinterpret_cast<PFN_vkCreateWaylandSurfaceKHR>(
-        vkGetInstanceProcAddr(instance, "vkCreateWaylandSurfaceKHR")
-    );
+    if (instance != m_vkInstance || !m_vkCreateWaylandSurface) {
+        m_vkCreateWaylandSurface = vkGetInstanceProcAddr(instance, "vkCreateWaylandSurfaceKHR");
+        m_vkInstance = instance;
+    }
+    auto fpCreateWaylandSurfaceKHR = reinterpret_cast<PFN_vkCreateWaylandSurfaceKHR>(m_vkCreateWaylandSurface);
     if (!fpCreateWaylandSurfaceKHR) {
         return (VkResult)(-1);
     }
-    return fpCreateWaylandSurfaceKHR(instance, &createInfo, allocator, surface);
+    const VkResult res = fpCreateWaylandSurfaceKHR(instance, &createInfo, allocator, surface);
+    // From here on the swapchain supplies the content; resizes no longer
+    // replace the placeholder SHM buffer.
+    if (res == VK_SUCCESS) window.m_vulkanOwned = true;
+    return res;
 #else
     (void)instance; (void)window; (void)allocator; (void)surface;
     return (VkResult)(-1);
 #endif
 }
 
-std::shared_ptr<wm::Window> WaylandWindowManager::createWindow(int width, int height, const std::string &title)
+std::shared_ptr<wm::Window> WaylandWindowManager::createWindow(int width, int height, std::string_view title)
+{
+    return createNativeWindow(width, height, title);
+}
+
+std::shared_ptr<WaylandWindow> WaylandWindowManager::createNativeWindow(int width, int height, std::string_view title)
 {
-    auto win = std::make_shared<WaylandWindow>(*this, width, height, title);
+    // Prefer a configured record whose buffer already has the right size.
+    const auto score = [width, height](const WaylandWindow *w) {
+        return (w->m_configured ? 2 : 0) + (w->m_buf.width == width && w->m_buf.height == height ? 1 : 0);
+    };
+    WaylandWindow *record = nullptr;
+    const auto best = std::ranges::max_element(m_pool, {}, score);
+    if (best != m_pool.end()) {
+        record = *best;
+        m_pool.erase(best);
+        record->unpark(width, height, title);
+        // Its configure arrived while parked and was not reported; the new
+        // owner still gets one WindowConfigured, as for a fresh window.
+        if (record->m_configured) queueEvent(*record, wm::WmEvent::WindowConfigured);
+    } else {
+        record = new_window(width, height, title);
+    }
+
+    // Control block and record come from the manager's resource.
+    std::shared_ptr<WaylandWindow> win(record, WindowRecycler{this, m_resource}, std::pmr::polymorphic_allocator<>(m_resource));
     m_windows.emplace_back(win);
     return win;
 }
 
+void WaylandWindowManager::prewarmWindows(const size_t count, const int width, const int height)
+{
+    if (!m_display) return;
+    for (size_t i = 0; i < count; ++i) {
+        WaylandWindow *window = new_window(width, height, {});
+        window->park();
+        m_pool.push_back(window);
+    }
+    m_poolLimit = std::max(m_poolLimit, m_pool.size());
+    // One round trip for the whole batch; configure events for parked
+    // records only update their state.
+    wl_display_roundtrip(m_display);
+}
+
+WaylandWindow *WaylandWindowManager::new_window(const int width, const int height, const std::string_view title)
+{
+    return std::pmr::polymorphic_allocator<WaylandWindow>(m_resource).new_object<WaylandWindow>(*this, width, height, title);
+}
+
+void WaylandWindowManager::destroy_window(WaylandWindow *window)
+{
+    std::pmr::polymorphic_allocator<WaylandWindow>(m_resource).delete_object(window);
+}
+
+void WaylandWindowManager::WindowRecycler::operator()(WaylandWindow *window) const
+{
+    if (window->m_detached) std::pmr::polymorphic_allocator<WaylandWindow>(resource).delete_object(window);
+    else mgr->recycle(window);
+}
+
+void WaylandWindowManager::recycle(WaylandWindow *window)
+{
+    if (m_pool.size() >= m_poolLimit) {
+        destroy_window(window);
+        return;
+    }
+    window->park();
+    m_pool.push_back(window);
+}
+
 int WaylandWindowManager::run()
 {
     if (!m_display) return 1;
-    while (!m_should_quit && wl_display_dispatch(m_display) != -1) {
-        for (auto &weak_win : m_windows) {
-            if (auto win = weak_win.lock()) {
-                static_cast<WaylandWindow*>(win.get())->mapIfNeeded();
-            }
-        }
+    while (!m_should_quit && pumpEvents(true)) {
+        dispatch_callbacks();
     }
     return 0;
 }
@@ -157,44 +276,281 @@ void WaylandWindowManager::requestQuit()
 
 void WaylandWindowManager::pollEvents()
 {
-    if (!m_display) return;
-    for (auto &weak_win : m_windows) {
-        if (auto win = weak_win.lock()) {
-            static_cast<WaylandWindow*>(win.get())->mapIfNeeded();
+    pumpEvents(false);
+    dispatch_callbacks();
+}
+
+void WaylandWindowManager::waitEvents()
+{
+    pumpEvents(true);
+    dispatch_callbacks();
+}
+
+void WaylandWindowManager::beginBatch(const bool atomic)
+{
+    ++m_batchDepth;
+    m_batchAtomic = m_batchAtomic || atomic;
+}
+
+void WaylandWindowManager::endBatch()
+{
+    if (m_batchDepth == 0 || --m_batchDepth > 0) return;
+
+    // Layer modes are read now, since setDesync() may have run mid-batch.
+    for (BatchCommit &c : m_batchCommits) {
+        if (!c.layer) continue;
+        if (m_batchAtomic && c.layer->m_desync) wl_subsurface_set_sync(c.layer->m_subsurface);
+        if (m_batchAtomic || !c.layer->m_desync) c.parent = c.layer->m_parent->surface();
+    }
+
+    // A synchronized subsurface's commit only caches its state and the
+    // parent's commit applies it, so children go first and a child
+    // committed on its own brings its parent along.
+    for (size_t i = 0, n = m_batchCommits.size(); i < n; ++i) {
+        const BatchCommit c = m_batchCommits[i];
+        if (!c.parent) continue;
+        wl_surface_commit(c.surface);
+        if (std::ranges::none_of(m_batchCommits, [&c](const BatchCommit &o) { return o.surface == c.parent; })) {
+            m_batchCommits.push_back(BatchCommit{.surface = c.parent});
         }
     }
-    wl_display_dispatch_pending(m_display);
-    wl_display_flush(m_display);
-
-    const int fd = wl_display_get_fd(m_display);
-    if (fd >= 0) {
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        timeval tv{};
-        if (select(fd + 1, &fds, nullptr, nullptr, &tv) > 0 && FD_ISSET(fd, &fds)) {
-            wl_display_dispatch(m_display);
+    for (const BatchCommit &c : m_batchCommits) {
+        if (!c.parent) wl_surface_commit(c.surface);
+    }
+    // Switching back applies nothing: the cached state went out with the parent.
+    if (m_batchAtomic) {
+        for (const BatchCommit &c : m_batchCommits) {
+            if (c.layer && c.layer->m_desync) wl_subsurface_set_desync(c.layer->m_subsurface);
         }
     }
+
+    m_batchCommits.clear();
+    m_batchAtomic = false;
+    if (m_display) wl_display_flush(m_display);
 }
 
-void WaylandWindowManager::waitEvents()
+void WaylandWindowManager::requestCommit(wl_surface *surface, wl_surface *syncParent)
 {
-    if (!m_display) return;
+    if (!surface) return;
+    if (m_batchDepth == 0) {
+        wl_surface_commit(surface);
+        return;
+    }
+    // Pending state accumulates, so repeated commits fold into one.
+    for (const BatchCommit &c : m_batchCommits) {
+        if (c.surface == surface) return;
+    }
+    m_batchCommits.push_back(BatchCommit{.surface = surface, .parent = syncParent});
+}
+
+void WaylandWindowManager::requestCommit(WaylandLayer &layer)
+{
+    if (m_batchDepth == 0) {
+        wl_surface_commit(layer.m_surface);
+        // A synchronized layer's content only shows with its parent.
+        if (!layer.m_desync) layer.commit_parent();
+        return;
+    }
+    for (const BatchCommit &c : m_batchCommits) {
+        if (c.surface == layer.m_surface) return;
+    }
+    m_batchCommits.push_back(BatchCommit{.surface = layer.m_surface, .layer = &layer});
+}
+
+void WaylandWindowManager::forgetSurface(const wl_surface *surface)
+{
+    if (!surface) return;
+    std::erase_if(m_batchCommits, [surface](const BatchCommit &c) { return c.surface == surface || c.parent == surface; });
+}
+
+void WaylandWindowManager::map_windows()
+{
+    // Records of destroyed windows were recycled or freed; drop their slots.
+    std::erase_if(m_windows, [](const std::weak_ptr<WaylandWindow> &w) { return w.expired(); });
     for (auto &weak_win : m_windows) {
         if (auto win = weak_win.lock()) {
-            static_cast<WaylandWindow*>(win.get())->mapIfNeeded();
+            win->mapIfNeeded();
         }
     }
-    wl_display_flush(m_display);
-    wl_display_dispatch(m_display);
+}
+
+bool WaylandWindowManager::pumpEvents(const bool block)
+{
+    if (!m_display) return false;
+    map_windows();
+
+    int dispatched = 0;
+    while (wl_display_prepare_read(m_display) != 0) {
+        const int n = wl_display_dispatch_pending(m_display);
+        if (n < 0) return false;
+        dispatched += n;
+    }
+    // Never sleep on the socket with something already waiting for delivery,
+    // e.g. events a show() round trip queued or that were just dispatched.
+    const bool wait = block && dispatched == 0 && m_pending.empty();
+    // A blocking wait inside a batch still flushes: it may be waiting on a
+    // reply to something still sitting in the buffer.
+    if (m_batchDepth == 0 || wait) wl_display_flush(m_display);
+
+    // The display and every clipboard/drag transfer pipe share one poll, so
+    // waiting for input also keeps transfers streaming.
+    m_pollFds.clear();
+    m_pollFds.push_back(pollfd{.fd = wl_display_get_fd(m_display), .events = POLLIN, .revents = 0});
+    if (m_dataDevice) m_dataDevice->appendPollFds(m_pollFds);
+
+    if (poll(m_pollFds.data(), m_pollFds.size(), wait ? -1 : 0) > 0 && (m_pollFds[0].revents & POLLIN)) {
+        if (wl_display_read_events(m_display) < 0) return false;
+    } else {
+        wl_display_cancel_read(m_display);
+    }
+
+    if (m_dataDevice) m_dataDevice->service(std::span<const pollfd>(m_pollFds).subspan(1));
+    const bool ok = wl_display_dispatch_pending(m_display) != -1;
+    // Everything read in this pump is delivered as one summed motion.
+    flush_relative_motion();
+    return ok;
+}
+
+void WaylandWindowManager::dispatch_callbacks()
+{
+    dispatchQueued([](WaylandWindow &win, const auto &ev) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(ev)>, wm::MouseEvent>) {
+            if (win.m_mouseCb) win.m_mouseCb(ev, win);
+        } else if constexpr (std::is_same_v<std::decay_t<decltype(ev)>, wm::DropEvent>) {
+            if (win.m_dropCb) win.m_dropCb(ev, win);
+        } else if constexpr (std::is_same_v<std::decay_t<decltype(ev)>, wm::TouchFrame>) {
+            if (win.m_touchCb) win.m_touchCb(ev, win);
+        } else if constexpr (std::is_same_v<std::decay_t<decltype(ev)>, wm::RelativeMotion>) {
+            if (win.m_relativeCb) win.m_relativeCb(ev, win);
+        } else {
+            if (win.m_windowEventCb) win.m_windowEventCb(ev, win);
+        }
+    });
+}
+
+void WaylandWindowManager::queueEvent(WaylandWindow &window, const wm::WmEvent event)
+{
+    // Parked records still get configure and focus events; nobody owns them.
+    if (window.m_pooled) return;
+    m_pending.push_back(PendingEvent{.window = &window, .payload = event});
+}
+
+void WaylandWindowManager::queueMouseEvent(WaylandWindow &window, const wm::MouseEvent &event)
+{
+    // Relative motion summed so far happened before this press or scroll;
+    // queue it first so the two streams stay in order. Moves keep folding.
+    if (event.action != wm::MouseAction::Move) flush_relative_motion();
+    m_pending.push_back(PendingEvent{.window = &window, .payload = event});
+}
+
+void WaylandWindowManager::queueDropEvent(WaylandWindow &window, const wm::DropEvent &event)
+{
+    m_pending.push_back(PendingEvent{.window = &window, .payload = event});
+}
+
+void WaylandWindowManager::queueTouchFrame(WaylandWindow &window, const wm::TouchFrame &frame)
+{
+    m_pending.push_back(PendingEvent{.window = &window, .payload = frame});
+}
+
+void WaylandWindowManager::release_event_storage()
+{
+    if (m_touch) m_touch->resetArena();
+}
+
+void WaylandWindowManager::forgetWindow(const WaylandWindow *window)
+{
+    std::erase_if(m_pending, [window](const PendingEvent &ev) { return ev.window == window; });
+    for (auto &ev : m_dispatching) {
+        if (ev.window == window) ev.window = nullptr;
+    }
+    if (m_dataDevice) m_dataDevice->forgetWindow(window);
+    if (m_pointerFocus == window) {
+        m_pointerFocus = nullptr;
+        m_pointerSurface = nullptr;
+    }
+    if (m_touch) m_touch->forgetWindow(window);
+    if (m_relativeWindow == window) {
+        m_relativeWindow = nullptr;
+        m_relative = wm::RelativeMotion{};
+    }
+}
+
+void WaylandWindowManager::updateCursor(const WaylandWindow &window)
+{
+    if (!m_pointer || m_pointerFocus != &window) return;
+    // Created on first use: no cursor surface or atlas until one is shown.
+    if (!m_cursor) m_cursor = std::make_unique<WaylandCursor>(*this, m_pointer, m_cursorShapeManager);
+    const wm::CursorShape shape = window.on_decoration(m_pointerSurface) ? wm::CursorShape::Default : window.cursor();
+    m_cursor->apply(shape, m_pointerSerial);
+}
+
+void WaylandWindowManager::bind_data_device()
+{
+    if (m_dataDevice && m_seat) m_dataDevice->bindSeat(m_seat);
+}
+
+std::span<const std::pmr::string> WaylandWindowManager::getClipboardMimeTypes() const
+{
+    return m_dataDevice ? m_dataDevice->clipboardMimeTypes() : std::span<const std::pmr::string>{};
+}
+
+bool WaylandWindowManager::receiveClipboard(const std::string_view mimeType, const wm::DataChunkCallback &cb, const int sinkFd)
+{
+    return m_dataDevice && m_dataDevice->receiveClipboard(mimeType, cb, sinkFd);
+}
+
+bool WaylandWindowManager::setClipboard(const std::span<const std::string_view> mimeTypes, const wm::DataProvider &provider)
+{
+    return m_dataDevice && m_dataDevice->setClipboard(mimeTypes, provider, m_inputSerial);
+}
+
+void WaylandWindowManager::clearClipboard()
+{
+    if (m_dataDevice) m_dataDevice->clearClipboard(m_inputSerial);
+}
+
+std::span<const std::pmr::string> WaylandWindowManager::getDropMimeTypes() const
+{
+    return m_dataDevice ? m_dataDevice->dropMimeTypes() : std::span<const std::pmr::string>{};
+}
+
+void WaylandWindowManager::acceptDrop(const std::string_view mimeType)
+{
+    if (m_dataDevice) m_dataDevice->acceptDrop(mimeType);
+}
+
+bool WaylandWindowManager::receiveDrop(const std::string_view mimeType, const wm::DataChunkCallback &cb, const int sinkFd)
+{
+    return m_dataDevice && m_dataDevice->receiveDrop(mimeType, cb, sinkFd);
+}
+
+bool WaylandWindowManager::startCapture(const wm::CaptureConfig &config)
+{
+    if (!m_capture) m_capture = std::make_unique<capture_impl::FrameCapture>(m_resource);
+    m_captureRunning = m_capture->start(config);
+    return m_captureRunning;
+}
+
+void WaylandWindowManager::stopCapture()
+{
+    if (m_capture) m_capture->stop();
+    m_captureRunning = false;
+}
+
+wm::CaptureStats WaylandWindowManager::getCaptureStats() const
+{
+    return m_capture ? m_capture->stats() : wm::CaptureStats{};
 }
 
 void WaylandWindowManager::handle_global(void *data, wl_registry *registry, const uint32_t name, const char *interface, const uint32_t version)
 {
     auto *self = static_cast<WaylandWindowManager *>(data);
     if (strcmp(interface, wl_compositor_interface.name) == 0) {
-        self->m_compositor = static_cast<wl_compositor *>(wl_registry_bind(registry, name, &wl_compositor_interface, version < 4 ? version : 4));
+        self->m_compositorVersion = version < 4 ? version : 4;
+        self->m_compositor = static_cast<wl_compositor *>(wl_registry_bind(registry, name, &wl_compositor_interface, self->m_compositorVersion));
+    } else if (strcmp(interface, wl_subcompositor_interface.name) == 0) {
+        self->m_subcompositor = static_cast<wl_subcompositor *>(wl_registry_bind(registry, name, &wl_subcompositor_interface, 1));
     } else if (strcmp(interface, wl_shm_interface.name) == 0) {
         self->m_shm = static_cast<wl_shm *>(wl_registry_bind(registry, name, &wl_shm_interface, 1));
     } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
@@ -207,7 +563,25 @@ void WaylandWindowManager::handle_global(void *data, wl_registry *registry, cons
             .name = WaylandWindowManager::handle_seat_name,
         };
         wl_seat_add_listener(self->m_seat, &SEAT_LISTENER, self);
+        self->bind_data_device();
+    } else if (strcmp(interface, wl_data_device_manager_interface.name) == 0) {
+        auto *manager = static_cast<wl_data_device_manager *>(wl_registry_bind(registry, name, &wl_data_device_manager_interface, version < 3 ? version : 3));
+        self->m_dataDevice = std::make_unique<WaylandDataDevice>(*self, manager, version < 3 ? version : 3);
+        self->bind_data_device();
+    }
+    else if (strcmp(interface, zwp_relative_pointer_manager_v1_interface.name) == 0) {
+        self->m_relativePointerManager = static_cast<zwp_relative_pointer_manager_v1 *>(wl_registry_bind(registry, name, &zwp_relative_pointer_manager_v1_interface, 1));
+        self->setup_relative_pointer();
+    } else if (strcmp(interface, zwp_pointer_constraints_v1_interface.name) == 0) {
+        self->m_pointerConstraints = static_cast<zwp_pointer_constraints_v1 *>(wl_registry_bind(registry, name, &zwp_pointer_constraints_v1_interface, 1));
+    } else if (strcmp(interface, zxdg_decoration_manager_v1_interface.name) == 0) {
+        self->m_decorationManager = static_cast<zxdg_decoration_manager_v1 *>(wl_registry_bind(registry, name, &zxdg_decoration_manager_v1_interface, 1));
     }
+#ifdef WM_HAVE_CURSOR_SHAPE
+    else if (strcmp(interface, wp_cursor_shape_manager_v1_interface.name) == 0) {
+        self->m_cursorShapeManager = static_cast<wp_cursor_shape_manager_v1 *>(wl_registry_bind(registry, name, &wp_cursor_shape_manager_v1_interface, 1));
+    }
+#endif
 }
 
 void WaylandWindowManager::handle_global_remove(void *data, wl_registry *registry, const uint32_t name)
@@ -225,12 +599,55 @@ void WaylandWindowManager::handle_seat_capabilities(void *data, wl_seat *seat, c
 {
     auto *self = static_cast<WaylandWindowManager *>(data);
     (void)seat;
-    if (!(caps & WL_SEAT_CAPABILITY_POINTER)) return;
-    
-    for (auto &weak_win : self->m_windows) {
-        if (auto win = weak_win.lock()) {
-            static_cast<WaylandWindow *>(win.get())->setup_pointer(self);
+    self->setup_pointer((caps & WL_SEAT_CAPABILITY_POINTER) != 0);
+    self->setup_touch((caps & WL_SEAT_CAPABILITY_TOUCH) != 0);
+}
+
+void WaylandWindowManager::setup_touch(const bool available)
+{
+    if (available && !m_touch && m_seat) {
+        m_touch = std::make_unique<WaylandTouch>(*this, wl_seat_get_touch(m_seat), m_resource);
+    } else if (!available && m_touch) {
+        // Queued frames point into the touch arena.
+        const auto isTouch = [](const PendingEvent &ev) { return std::holds_alternative<wm::TouchFrame>(ev.payload); };
+        std::erase_if(m_pending, isTouch);
+        for (auto &ev : m_dispatching) {
+            if (isTouch(ev)) ev.window = nullptr;
         }
+        m_touch.reset();
+    }
+}
+
+static constexpr wl_pointer_listener POINTER_LISTENER = {
+    .enter = WaylandWindowManager::handle_pointer_enter,
+    .leave = WaylandWindowManager::handle_pointer_leave,
+    .motion = WaylandWindowManager::handle_pointer_motion,
+    .button = WaylandWindowManager::handle_pointer_button,
+    .axis = WaylandWindowManager::handle_pointer_axis,
+    .frame = WaylandWindowManager::handle_pointer_frame,
+    .axis_source = WaylandWindowManager::handle_pointer_axis_source,
+    .axis_stop = WaylandWindowManager::handle_pointer_axis_stop,
+    .axis_discrete = WaylandWindowManager::handle_pointer_axis_discrete,
+    .axis_value120 = WaylandWindowManager::handle_pointer_axis_value120,
+};
+
+void WaylandWindowManager::setup_pointer(const bool available)
+{
+    if (available && !m_pointer && m_seat) {
+        m_pointer = wl_seat_get_pointer(m_seat);
+        wl_pointer_add_listener(m_pointer, &POINTER_LISTENER, this);
+        setup_relative_pointer();
+        apply_constraints();
+    } else if (!available && m_pointer) {
+        m_cursor.reset();
+        // Objects created from the pointer go first.
+        wl_pointer *pointer = m_pointer;
+        m_pointer = nullptr;
+        setup_relative_pointer();
+        apply_constraints();
+        if (wl_pointer_get_version(pointer) >= WL_POINTER_RELEASE_SINCE_VERSION) wl_pointer_release(pointer);
+        else wl_pointer_destroy(pointer);
+        m_pointerFocus = nullptr;
     }
 }
 
@@ -248,38 +665,34 @@ static constexpr xdg_toplevel_listener XDG_TOPLEVEL_LISTENER = {
     .close = WaylandWindow::handle_toplevel_close,
 };
 
-WaylandWindow::WaylandWindow(WaylandWindowManager &mgr, const int width, const int height, const std::string &title)
-    : m_mgr(mgr), m_width(width), m_height(height), m_title(title), m_initialTitle(title)
+static constexpr zxdg_toplevel_decoration_v1_listener TOPLEVEL_DECORATION_LISTENER = {
+    .configure = WaylandWindow::handle_decoration_configure,
+};
+
+WaylandWindow::WaylandWindow(WaylandWindowManager &mgr, const int width, const int height, const std::string_view title)
+    : m_mgr(mgr), m_width(width), m_height(height),
+      m_title(title, mgr.getMemoryResource()), m_appId(mgr.getMemoryResource()),
+      m_initialTitle(title, mgr.getMemoryResource()), m_initialAppId(mgr.getMemoryResource())
 {
     m_surface = wl_compositor_create_surface(mgr.compositor());
+    // Lets seat-level listeners (data device, pointer) map a surface back to its window.
+    wl_surface_set_user_data(m_surface, this);
     m_xdg_surface = xdg_wm_base_get_xdg_surface(mgr.wm_base(), m_surface);
     xdg_surface_add_listener(m_xdg_surface, &XDG_SURFACE_LISTENER, this);
     m_toplevel = xdg_surface_get_toplevel(m_xdg_surface);
     xdg_toplevel_add_listener(m_toplevel, &XDG_TOPLEVEL_LISTENER, this);
-    xdg_toplevel_set_title(m_toplevel, title.c_str());
+    xdg_toplevel_set_title(m_toplevel, m_title.c_str());
 
-    setup_pointer(&mgr);
-    create_buffer(width, height, 0xFF2BB3AA);
-}
+    // Ask for server-side decorations; the title bar is only drawn here if
+    // the compositor answers client-side or has no decoration manager.
+    if (mgr.decorationManager()) {
+        m_toplevelDecoration = zxdg_decoration_manager_v1_get_toplevel_decoration(mgr.decorationManager(), m_toplevel);
+        zxdg_toplevel_decoration_v1_add_listener(m_toplevelDecoration, &TOPLEVEL_DECORATION_LISTENER, this);
+        zxdg_toplevel_decoration_v1_set_mode(m_toplevelDecoration, ZXDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE);
+    }
 
-void WaylandWindow::setup_pointer(WaylandWindowManager *mgr)
-{
-    if (!mgr || m_pointer || !mgr->seat()) return;
-    m_pointer = wl_seat_get_pointer(mgr->seat());
-    if (!m_pointer) return;
-    static constexpr wl_pointer_listener POINTER_LISTENER = {
-        .enter = handle_pointer_enter,
-        .leave = handle_pointer_leave,
-        .motion = handle_pointer_motion,
-        .button = handle_pointer_button,
-        .axis = handle_pointer_axis,
-        .frame = handle_pointer_frame,
-        .axis_source = handle_pointer_axis_source,
-        .axis_stop = handle_pointer_axis_stop,
-        .axis_discrete = handle_pointer_axis_discrete,
-        .axis_value120 = handle_pointer_axis_value120,
-    };
-    wl_pointer_add_listener(m_pointer, &POINTER_LISTENER, this);
+    create_buffer(width, height, 0xFF2BB3AA);
+    if (!m_toplevelDecoration) set_client_decorations(true);
 }
 
 void WaylandWindow::mapIfNeeded()
@@ -292,6 +705,8 @@ void WaylandWindow::mapIfNeeded()
             if (appIdToUse) xdg_toplevel_set_app_id(m_toplevel, appIdToUse);
             if (!m_title.empty()) xdg_toplevel_set_title(m_toplevel, m_title.c_str());
         }
+        // Not held back by a batch: nothing can map before the configure
+        // this asks for.
         wl_surface_commit(m_surface);
         m_initialCommitted = true;
         return;
@@ -304,29 +719,53 @@ void WaylandWindow::mapIfNeeded()
             if (!m_title.empty()) xdg_toplevel_set_title(m_toplevel, m_title.c_str());
         }
         wl_surface_attach(m_surface, m_buf.buffer, 0, 0);
-        wl_surface_commit(m_surface);
+        m_mgr.requestCommit(m_surface);
+        capture_buffer();
         m_mapped = true;
     }
 }
 
 WaylandWindow::~WaylandWindow()
 {
-    if (m_pointer) wl_pointer_destroy(m_pointer);
+    detach();
+}
+
+void WaylandWindow::detach()
+{
+    if (m_detached) return;
+    m_detached = true;
+    release_constraint();
+    m_mgr.forgetWindow(this);
+    m_mgr.forgetSurface(m_surface);
+    m_decoration.reset();
+    if (m_toplevelDecoration) zxdg_toplevel_decoration_v1_destroy(m_toplevelDecoration);
     if (m_toplevel) xdg_toplevel_destroy(m_toplevel);
     if (m_xdg_surface) xdg_surface_destroy(m_xdg_surface);
     if (m_surface) wl_surface_destroy(m_surface);
-    if (m_buf.buffer) wl_buffer_destroy(m_buf.buffer);
-    m_buf.data.reset();
-    if (m_buf.fd >= 0) close(m_buf.fd);
+    m_toplevelDecoration = nullptr;
+    m_toplevel = nullptr;
+    m_xdg_surface = nullptr;
+    m_surface = nullptr;
+    release_shm_buffer(m_buf);
+}
+
+void WaylandWindow::setTitle(const std::string_view title)
+{
+    // assign() reuses the existing capacity, so steady-state retitling does
+    // not allocate; unchanged titles skip the request entirely.
+    if (title == m_title) return;
+    m_title.assign(title);
+    if (m_toplevel) xdg_toplevel_set_title(m_toplevel, m_title.c_str());
 }
 
-void WaylandWindow::setTitle(const std::string &title)
+void WaylandWindow::setCursor(const wm::CursorShape shape)
 {
-    m_title = title;
-    if (m_toplevel) xdg_toplevel_set_title(m_toplevel, title.c_str());
+    if (shape == m_cursor) return;
+    m_cursor = shape;
+    m_mgr.updateCursor(*this);
 }
 
-void WaylandWindow::setAppId(const std::string &appId)
+void WaylandWindow::setAppId(const std::string_view appId)
 {
     if (!appId.empty()) {
         if (m_initialAppId.empty()) {
@@ -334,9 +773,9 @@ void WaylandWindow::setAppId(const std::string &appId)
         }
         m_appId = appId;
         if (m_toplevel) {
-            xdg_toplevel_set_app_id(m_toplevel, appId.c_str());
+            xdg_toplevel_set_app_id(m_toplevel, m_appId.c_str());
             if (!m_configured) {
-                wl_surface_commit(m_surface);
+                m_mgr.requestCommit(m_surface);
             }
         }
     } else {
@@ -354,13 +793,17 @@ void WaylandWindow::show() {
         }
     }
 
-    // Ensure an initial commit occurs so the compositor can send the first configure
-    if (m_surface) {
-        wl_surface_commit(m_surface);
-    }
-
-    while (!m_configured) {
-        if (wl_display_roundtrip(m_mgr.display()) < 0) break;
+    // Ensure an initial commit occurs so the compositor can send the first
+    // configure. It has to go out now, batch or not: the round trip waits
+    // for the answer. Pre-warmed records skip both.
+    if (!m_configured) {
+        if (m_surface) {
+            wl_surface_commit(m_surface);
+            m_initialCommitted = true;
+        }
+        while (!m_configured) {
+            if (wl_display_roundtrip(m_mgr.display()) < 0) break;
+        }
     }
     if (m_buf.buffer && m_surface) {
         if (m_toplevel) {
@@ -372,7 +815,9 @@ void WaylandWindow::show() {
             if (!m_title.empty()) xdg_toplevel_set_title(m_toplevel, m_title.c_str());
         }
         wl_surface_attach(m_surface, m_buf.buffer, 0, 0);
-        wl_surface_commit(m_surface);
+        m_mgr.requestCommit(m_surface);
+        capture_buffer();
+        m_mapped = true;
     }
 }
 
@@ -381,20 +826,37 @@ void WaylandWindow::handle_xdg_surface_configure(void *data, xdg_surface *xdg_su
     auto *self = static_cast<WaylandWindow *>(data);
     xdg_surface_ack_configure(xdg_surface_obj, serial);
     self->m_configured = true;
-    if (self->m_windowEventCb) self->m_windowEventCb(wm::WmEvent::WindowConfigured, *self);
+    // A mapped SHM window commits nothing on its own afterwards; without
+    // this a resized buffer, redrawn title bar or new geometry would never
+    // show. The new buffer goes out only now, after the ack.
+    if (self->m_mapped) {
+        if (self->m_bufferChanged) {
+            wl_surface_attach(self->m_surface, self->m_buf.buffer, 0, 0);
+            wl_surface_damage(self->m_surface, 0, 0, self->m_buf.width, self->m_buf.height);
+        }
+        if (self->m_bufferChanged || self->m_decorationsChanged) self->m_mgr.requestCommit(self->m_surface);
+        if (self->m_bufferChanged) self->capture_buffer();
+    }
+    self->m_bufferChanged = false;
+    self->m_decorationsChanged = false;
+    self->m_mgr.queueEvent(*self, wm::WmEvent::WindowConfigured);
 }
 
 void WaylandWindow::handle_toplevel_configure(void *data, xdg_toplevel *toplevel, const int32_t width, const int32_t height, wl_array *states)
 {
     auto *self = static_cast<WaylandWindow *>(data);
     (void)toplevel;
-    if (!self || !self->m_windowEventCb) return;
+    if (!self) return;
     
-    if (width > 0 && height > 0) {
+    // Configured sizes cover the window geometry, title bar included.
+    const int32_t contentHeight = self->m_decoration ? height - WaylandDecoration::TITLEBAR_HEIGHT : height;
+    // Focus- and state-only configures repeat the current size; only a
+    // real change rebuilds the buffer.
+    if (width > 0 && contentHeight > 0 && (width != self->m_width || contentHeight != self->m_height)) {
         self->m_width = width;
-        self->m_height = height;
-        self->create_buffer(width, height, 0xFF030303);
-        self->m_windowEventCb(wm::WmEvent::WindowResized, *self);
+        self->m_height = contentHeight;
+        if (!self->m_vulkanOwned) self->m_bufferChanged = self->create_buffer(width, contentHeight, 0xFF030303);
+        self->m_mgr.queueEvent(*self, wm::WmEvent::WindowResized);
     }
     
     bool hasFocus = false;
@@ -411,23 +873,138 @@ void WaylandWindow::handle_toplevel_configure(void *data, xdg_toplevel *toplevel
     
     const bool wasFocused = self->m_hasFocus;
     self->m_hasFocus = hasFocus;
+    self->update_decorations();
     
     if (hasFocus && !wasFocused) {
-        self->m_windowEventCb(wm::WmEvent::WindowFocusGained, *self);
+        self->m_mgr.queueEvent(*self, wm::WmEvent::WindowFocusGained);
     } else if (!hasFocus && wasFocused) {
-        self->m_windowEventCb(wm::WmEvent::WindowFocusLost, *self);
+        self->m_mgr.queueEvent(*self, wm::WmEvent::WindowFocusLost);
+    }
+}
+
+void WaylandWindow::handle_decoration_configure(void *data, zxdg_toplevel_decoration_v1 *decoration, const uint32_t mode)
+{
+    auto *self = static_cast<WaylandWindow *>(data);
+    (void)decoration;
+    self->set_client_decorations(mode == ZXDG_TOPLEVEL_DECORATION_V1_MODE_CLIENT_SIDE);
+}
+
+void WaylandWindow::set_client_decorations(const bool enable)
+{
+    if (enable == static_cast<bool>(m_decoration)) return;
+    if (enable) {
+        std::pmr::memory_resource *resource = m_mgr.getMemoryResource();
+        m_decoration = std::unique_ptr<WaylandDecoration, DecorationDeleter>(
+            std::pmr::polymorphic_allocator<WaylandDecoration>(resource).new_object<WaylandDecoration>(m_mgr, *this),
+            DecorationDeleter{resource});
+    } else {
+        m_decoration.reset();
+    }
+    update_decorations();
+}
+
+void WaylandWindow::DecorationDeleter::operator()(WaylandDecoration *decoration) const
+{
+    std::pmr::polymorphic_allocator<WaylandDecoration>(resource).delete_object(decoration);
+}
+
+void WaylandWindow::update_decorations()
+{
+    if (!m_xdg_surface) return;
+    std::array<int32_t, 3> geometry{0, m_width, m_height};
+    if (m_decoration) {
+        m_decoration->setWidth(m_width);
+        m_decoration->setFocused(m_hasFocus);
+        if (m_decoration->update()) m_decorationsChanged = true;
+        geometry = {-WaylandDecoration::TITLEBAR_HEIGHT, m_width, m_height + WaylandDecoration::TITLEBAR_HEIGHT};
+    }
+    if (geometry != m_geometry) {
+        xdg_surface_set_window_geometry(m_xdg_surface, 0, geometry[0], geometry[1], geometry[2]);
+        m_geometry = geometry;
+        m_decorationsChanged = true;
+    }
+}
+
+bool WaylandWindow::on_decoration(const wl_surface *surface) const
+{
+    return surface && m_decoration && m_decoration->surface() == surface;
+}
+
+void WaylandWindow::decoration_button(const double x, const double y, const uint32_t serial, const bool pressed)
+{
+    if (!pressed || !m_decoration) return;
+    switch (m_decoration->hitTest(x, y)) {
+        case WaylandDecoration::Hit::Title:
+            if (m_toplevel && m_mgr.seat()) xdg_toplevel_move(m_toplevel, m_mgr.seat(), serial);
+            break;
+        case WaylandDecoration::Hit::Close:
+            m_shouldClose = true;
+            m_mgr.queueEvent(*this, wm::WmEvent::WindowCloseRequested);
+            break;
+        case WaylandDecoration::Hit::None:
+            break;
     }
 }
 
+void WaylandWindow::park()
+{
+    m_pooled = true;
+    release_constraint();
+    m_mgr.forgetWindow(this);
+    m_mgr.forgetSurface(m_surface);
+    m_windowEventCb = {};
+    m_mouseCb = {};
+    m_dropCb = {};
+    m_touchCb = {};
+    m_relativeCb = {};
+    m_constraint = wm::PointerConstraint::None;
+    m_cursor = wm::CursorShape::Default;
+    m_shouldClose = false;
+    // The owner's Vulkan surface is gone with it.
+    m_vulkanOwned = false;
+
+    if (m_mapped) {
+        // A null attach unmaps the toplevel; the following commit is a new
+        // initial commit, answered by a configure while the record waits.
+        wl_surface_attach(m_surface, nullptr, 0, 0);
+        wl_surface_commit(m_surface);
+        m_mapped = false;
+        m_configured = false;
+        m_initialCommitted = false;
+    }
+    if (!m_initialCommitted) {
+        wl_surface_commit(m_surface);
+        m_initialCommitted = true;
+    }
+}
+
+void WaylandWindow::unpark(const int width, const int height, const std::string_view title)
+{
+    m_pooled = false;
+    m_shouldClose = false;
+    m_title.assign(title);
+    m_initialTitle.assign(title);
+    // The compositor still holds the previous owner's app_id; clear it so
+    // the new owner does not inherit it when it sets none of its own.
+    if (m_toplevel && (!m_appId.empty() || !m_initialAppId.empty())) xdg_toplevel_set_app_id(m_toplevel, "");
+    m_appId.clear();
+    m_initialAppId.clear();
+    if (m_toplevel) xdg_toplevel_set_title(m_toplevel, m_title.c_str());
+    if (m_buf.width != width || m_buf.height != height) create_buffer(width, height, 0xFF2BB3AA);
+    m_width = width;
+    m_height = height;
+    update_decorations();
+}
+
 void WaylandWindow::handle_toplevel_close(void *data, xdg_toplevel *toplevel)
 {
     auto *self = static_cast<WaylandWindow *>(data);
     (void)toplevel;
     self->m_shouldClose = true;
-    if (self->m_windowEventCb) self->m_windowEventCb(wm::WmEvent::WindowCloseRequested, *self);
+    self->m_mgr.queueEvent(*self, wm::WmEvent::WindowCloseRequested);
 }
 
-int WaylandWindow::create_shm_file(const size_t size)
+int create_shm_file(const size_t size)
 {
     static int counter = 0;
     char name[64];
@@ -442,29 +1019,60 @@ int WaylandWindow::create_shm_file(const size_t size)
     return fd;
 }
 
-bool WaylandWindow::create_buffer(const int width, const int height, const uint32_t xrgb)
+bool create_shm_buffer(wl_shm *shm, const int width, const int height, const uint32_t format, ShmBuffer &out)
 {
-    m_buf.width = width;
-    m_buf.height = height;
-    m_buf.stride = width * 4;
-    m_buf.size = static_cast<size_t>(m_buf.stride) * height;
+    release_shm_buffer(out);
+    out.width = width;
+    out.height = height;
+    out.stride = width * 4;
+    out.size = static_cast<size_t>(out.stride) * height;
 
-    m_buf.fd = create_shm_file(m_buf.size);
-    if (m_buf.fd < 0) return false;
+    out.fd = create_shm_file(out.size);
+    if (out.fd < 0) return false;
 
-    void *raw_data = mmap(nullptr, m_buf.size, PROT_READ | PROT_WRITE, MAP_SHARED, m_buf.fd, 0);
+    void *raw_data = mmap(nullptr, out.size, PROT_READ | PROT_WRITE, MAP_SHARED, out.fd, 0);
     if (raw_data == MAP_FAILED) {
-        close(m_buf.fd);
-        m_buf.fd = -1;
+        close(out.fd);
+        out.fd = -1;
         return false;
     }
 
-    MmapDeleter deleter{.m_size = m_buf.size};
-    m_buf.data = MmapUniquePtr(raw_data, deleter);
+    MmapDeleter deleter{.m_size = out.size};
+    out.data = MmapUniquePtr(raw_data, deleter);
 
-    wl_shm_pool *pool = wl_shm_create_pool(m_mgr.shm(), m_buf.fd, static_cast<int>(m_buf.size));
-    m_buf.buffer = wl_shm_pool_create_buffer(pool, 0, width, height, m_buf.stride, WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool *pool = wl_shm_create_pool(shm, out.fd, static_cast<int>(out.size));
+    out.buffer = wl_shm_pool_create_buffer(pool, 0, width, height, out.stride, format);
     wl_shm_pool_destroy(pool);
+    return out.buffer != nullptr;
+}
+
+void release_shm_buffer(ShmBuffer &buf)
+{
+    if (buf.buffer) wl_buffer_destroy(buf.buffer);
+    buf.buffer = nullptr;
+    buf.data.reset();
+    if (buf.fd >= 0) close(buf.fd);
+    buf.fd = -1;
+}
+
+void WaylandWindow::capture_buffer()
+{
+    capture_impl::FrameCapture *capture = m_mgr.capture();
+    if (!capture || !m_buf.data) return;
+    const capture_impl::CaptureRect full{.width = m_buf.width, .height = m_buf.height};
+    capture->submit(capture_impl::CaptureSurface{
+        .id = wl_proxy_get_id(reinterpret_cast<wl_proxy *>(m_surface)),
+        .width = m_buf.width,
+        .height = m_buf.height,
+        .stride = m_buf.stride,
+        .pixelFormat = WL_SHM_FORMAT_XRGB8888,
+        .pixels = m_buf.data.get(),
+    }, std::span(&full, 1));
+}
+
+bool WaylandWindow::create_buffer(const int width, const int height, const uint32_t xrgb)
+{
+    if (!create_shm_buffer(m_mgr.shm(), width, height, WL_SHM_FORMAT_XRGB8888, m_buf)) return false;
 
     auto *pixels = static_cast<uint32_t *>(m_buf.data.get());
     for (int y = 0; y < height; ++y) {
@@ -475,43 +1083,68 @@ bool WaylandWindow::create_buffer(const int width, const int height, const uint3
     return true;
 }
 
-void WaylandWindow::handle_pointer_enter(void *data, wl_pointer *pointer, const uint32_t serial, wl_surface *surface, const wl_fixed_t x, const wl_fixed_t y)
+void WaylandWindowManager::handle_pointer_enter(void *data, wl_pointer *pointer, const uint32_t serial, wl_surface *surface, const wl_fixed_t x, const wl_fixed_t y)
 {
-    auto *self = static_cast<WaylandWindow *>(data);
-    (void)pointer; (void)serial; (void)surface;
-    if (!self) return;
-    
-    self->m_pointerX = wl_fixed_to_double(x);
-    self->m_pointerY = wl_fixed_to_double(y);
+    auto *self = static_cast<WaylandWindowManager *>(data);
+    (void)pointer;
+    // Layers carry their parent window as user data and take no input, so
+    // this is always a toplevel and coordinates are window-relative.
+    auto *win = surface ? static_cast<WaylandWindow *>(wl_surface_get_user_data(surface)) : nullptr;
+    self->m_pointerFocus = win;
+    self->m_pointerSurface = surface;
+    self->m_pointerSerial = serial;
+    self->m_surfaceX = wl_fixed_to_double(x);
+    self->m_surfaceY = wl_fixed_to_double(y);
+    if (!win) return;
+
+    if (!win->on_decoration(surface)) {
+        win->m_pointerX = self->m_surfaceX;
+        win->m_pointerY = self->m_surfaceY;
+    }
+    self->updateCursor(*win);
 }
 
-void WaylandWindow::handle_pointer_leave(void *data, wl_pointer *pointer, const uint32_t serial, wl_surface *surface)
+void WaylandWindowManager::handle_pointer_leave(void *data, wl_pointer *pointer, const uint32_t serial, wl_surface *surface)
 {
-    (void)data; (void)pointer; (void)serial; (void)surface;
+    auto *self = static_cast<WaylandWindowManager *>(data);
+    (void)pointer; (void)serial; (void)surface;
+    self->flush_relative_motion();
+    self->m_pointerFocus = nullptr;
+    self->m_pointerSurface = nullptr;
 }
 
-void WaylandWindow::handle_pointer_motion(void *data, wl_pointer *pointer, const uint32_t time, const wl_fixed_t x, const wl_fixed_t y)
+void WaylandWindowManager::handle_pointer_motion(void *data, wl_pointer *pointer, const uint32_t time, const wl_fixed_t x, const wl_fixed_t y)
 {
-    auto *self = static_cast<WaylandWindow *>(data);
+    auto *self = static_cast<WaylandWindowManager *>(data);
     (void)pointer; (void)time;
-    if (!self || !self->m_mouseCb) return;
+    WaylandWindow *win = self->m_pointerFocus;
+    if (!win) return;
+    self->m_surfaceX = wl_fixed_to_double(x);
+    self->m_surfaceY = wl_fixed_to_double(y);
+    if (win->on_decoration(self->m_pointerSurface)) return;
     
-    self->m_pointerX = wl_fixed_to_double(x);
-    self->m_pointerY = wl_fixed_to_double(y);
+    win->m_pointerX = self->m_surfaceX;
+    win->m_pointerY = self->m_surfaceY;
     
     wm::MouseEvent ev{
-        .x = self->m_pointerX,
-        .y = self->m_pointerY,
+        .x = win->m_pointerX,
+        .y = win->m_pointerY,
         .action = wm::MouseAction::Move
     };
-    self->m_mouseCb(ev, *self);
+    self->queueMouseEvent(*win, ev);
 }
 
-void WaylandWindow::handle_pointer_button(void *data, wl_pointer *pointer, const uint32_t serial, const uint32_t time, const uint32_t button, const uint32_t state)
+void WaylandWindowManager::handle_pointer_button(void *data, wl_pointer *pointer, const uint32_t serial, const uint32_t time, const uint32_t button, const uint32_t state)
 {
-    auto *self = static_cast<WaylandWindow *>(data);
-    (void)pointer; (void)serial; (void)time;
-    if (!self || !self->m_mouseCb) return;
+    auto *self = static_cast<WaylandWindowManager *>(data);
+    (void)pointer; (void)time;
+    self->noteInputSerial(serial);
+    WaylandWindow *win = self->m_pointerFocus;
+    if (!win) return;
+    if (win->on_decoration(self->m_pointerSurface)) {
+        win->decoration_button(self->m_surfaceX, self->m_surfaceY, serial, state == WL_POINTER_BUTTON_STATE_PRESSED);
+        return;
+    }
 
     wm::MouseButton mb = wm::MouseButton::Left;
     if (button == BTN_LEFT) mb = wm::MouseButton::Left;
@@ -519,24 +1152,25 @@ void WaylandWindow::handle_pointer_button(void *data, wl_pointer *pointer, const
     else if (button == BTN_MIDDLE) mb = wm::MouseButton::Middle;
 
     wm::MouseEvent ev{
-        .x = self->m_pointerX,
-        .y = self->m_pointerY,
+        .x = win->m_pointerX,
+        .y = win->m_pointerY,
         .button = mb,
         .action = (state == WL_POINTER_BUTTON_STATE_PRESSED) ? wm::MouseAction::Press : wm::MouseAction::Release
     };
-    self->m_mouseCb(ev, *self);
+    self->queueMouseEvent(*win, ev);
 }
 
-void WaylandWindow::handle_pointer_axis(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis, wl_fixed_t value)
+void WaylandWindowManager::handle_pointer_axis(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis, wl_fixed_t value)
 {
-    auto *self = static_cast<WaylandWindow *>(data);
+    auto *self = static_cast<WaylandWindowManager *>(data);
     (void)pointer; (void)time;
-    if (!self || !self->m_mouseCb) return;
+    WaylandWindow *win = self->m_pointerFocus;
+    if (!win || win->on_decoration(self->m_pointerSurface)) return;
     
     const double delta = wl_fixed_to_double(value);
     wm::MouseEvent ev{
-        .x = self->m_pointerX,
-        .y = self->m_pointerY,
+        .x = win->m_pointerX,
+        .y = win->m_pointerY,
         .action = wm::MouseAction::Wheel
     };
     
@@ -546,34 +1180,200 @@ void WaylandWindow::handle_pointer_axis(void *data, wl_pointer *pointer, uint32_
         ev.deltaX = delta;
     }
     
-    self->m_mouseCb(ev, *self);
+    self->queueMouseEvent(*win, ev);
 }
 
-void WaylandWindow::handle_pointer_frame(void *data, wl_pointer *pointer)
+void WaylandWindowManager::handle_pointer_frame(void *data, wl_pointer *pointer)
 {
     (void)data; (void)pointer;
 }
 
-void WaylandWindow::handle_pointer_axis_source(void *data, wl_pointer *pointer, uint32_t axis_source)
+void WaylandWindowManager::handle_pointer_axis_source(void *data, wl_pointer *pointer, uint32_t axis_source)
 {
     (void)data; (void)pointer; (void)axis_source;
 }
 
-void WaylandWindow::handle_pointer_axis_stop(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis)
+void WaylandWindowManager::handle_pointer_axis_stop(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis)
 {
     (void)data; (void)pointer; (void)time; (void)axis;
 }
 
-void WaylandWindow::handle_pointer_axis_discrete(void *data, wl_pointer *pointer, uint32_t axis, int32_t discrete)
+void WaylandWindowManager::handle_pointer_axis_discrete(void *data, wl_pointer *pointer, uint32_t axis, int32_t discrete)
 {
     (void)data; (void)pointer; (void)axis; (void)discrete;
 }
 
-void WaylandWindow::handle_pointer_axis_value120(void *data, wl_pointer *pointer, uint32_t axis, int32_t value120)
+void WaylandWindowManager::handle_pointer_axis_value120(void *data, wl_pointer *pointer, uint32_t axis, int32_t value120)
 {
     (void)data; (void)pointer; (void)axis; (void)value120;
 }
 
-} // namespace wm::wayland_impl
+std::shared_ptr<wm::Layer> WaylandWindow::createLayer(const int x, const int y, const int width, const int height)
+{
+    if (!m_surface || !m_mgr.subcompositor() || width <= 0 || height <= 0) return nullptr;
+    auto layer = std::allocate_shared<WaylandLayer>(
+        std::pmr::polymorphic_allocator<WaylandLayer>(m_mgr.getMemoryResource()),
+        shared_from_this(), x, y, width, height);
+    if (!layer->valid()) return nullptr;
+    return layer;
+}
 
+static constexpr wl_buffer_listener LAYER_BUFFER_LISTENER = {
+    .release = WaylandLayer::handle_buffer_release,
+};
 
+WaylandLayer::WaylandLayer(std::shared_ptr<WaylandWindow> parent, const int x, const int y, const int width, const int height)
+    : m_parent(std::move(parent))
+{
+    WaylandWindowManager &mgr = m_parent->m_mgr;
+    m_surface = wl_compositor_create_surface(mgr.compositor());
+    wl_surface_set_user_data(m_surface, m_parent.get());
+    // Empty input region: pointer events fall through to the parent surface.
+    wl_region *noInput = wl_compositor_create_region(mgr.compositor());
+    wl_surface_set_input_region(m_surface, noInput);
+    wl_region_destroy(noInput);
+    m_subsurface = wl_subcompositor_get_subsurface(mgr.subcompositor(), m_surface, m_parent->surface());
+    wl_subsurface_set_position(m_subsurface, x, y);
+    wl_subsurface_set_desync(m_subsurface);
+    m_x = x;
+    m_y = y;
+    if (create_shm_buffer(mgr.shm(), width, height, WL_SHM_FORMAT_ARGB8888, m_buf)) {
+        wl_buffer_add_listener(m_buf.buffer, &LAYER_BUFFER_LISTENER, this);
+        std::memset(m_buf.data.get(), 0, m_buf.size);
+    }
+    // A new subsurface joins the scene with the parent's next commit.
+    commit_parent();
+}
+
+WaylandLayer::~WaylandLayer()
+{
+    if (m_parent->m_detached) {
+        // The display is gone with the manager: its proxies cannot be
+        // destroyed any more, only the local mapping and fd released.
+        m_buf.buffer = nullptr;
+        release_shm_buffer(m_buf);
+        return;
+    }
+    m_parent->m_mgr.forgetSurface(m_surface);
+    if (m_subsurface) wl_subsurface_destroy(m_subsurface);
+    if (m_surface) wl_surface_destroy(m_surface);
+    release_shm_buffer(m_buf);
+    // The parent's next commit drops the subsurface from the scene.
+    if (m_parent->surface()) m_parent->m_mgr.requestCommit(m_parent->surface());
+}
+
+void WaylandLayer::setPosition(const int x, const int y)
+{
+    if (x == m_x && y == m_y) return;
+    if (m_subsurface) wl_subsurface_set_position(m_subsurface, x, y);
+    m_x = x;
+    m_y = y;
+    commit_parent();
+}
+
+void WaylandLayer::setDesync(const bool desync)
+{
+    if (!m_subsurface) return;
+    m_desync = desync;
+    if (desync) wl_subsurface_set_desync(m_subsurface);
+    else wl_subsurface_set_sync(m_subsurface);
+}
+
+void WaylandLayer::setVisible(const bool visible)
+{
+    if (visible == m_visible) return;
+    m_visible = visible;
+    m_fullDamage = true;
+    if (!visible) {
+        if (!m_surface) return;
+        wl_surface_attach(m_surface, nullptr, 0, 0);
+        m_parent->m_mgr.requestCommit(*this);
+        m_attached = false;
+        return;
+    }
+    // The layer surface holds no buffer while hidden: re-attach the current
+    // pixels with full damage, then let the parent's commit show it.
+    commit();
+    commit_parent();
+}
+
+void WaylandLayer::commit_parent()
+{
+    // Before mapping, the window's own map commit carries the change.
+    if (m_parent->m_mapped) m_parent->m_mgr.requestCommit(m_parent->surface());
+}
+
+std::span<uint32_t> WaylandLayer::pixels()
+{
+    if (!m_buf.data) return {};
+    return {static_cast<uint32_t *>(m_buf.data.get()), m_buf.size / sizeof(uint32_t)};
+}
+
+void WaylandLayer::damage(const int x, const int y, const int width, const int height)
+{
+    if (m_fullDamage) return;
+    if (m_damageCount == MAX_DAMAGE_RECTS) {
+        m_fullDamage = true;
+        return;
+    }
+    m_damage[m_damageCount++] = Rect{.x = x, .y = y, .width = width, .height = height};
+}
+
+void WaylandLayer::commit()
+{
+    if (!m_surface || !m_buf.buffer || !m_visible) return;
+    if (!m_fullDamage && m_damageCount == 0 && m_attached) return;
+
+    const bool bufferDamage = m_parent->m_mgr.compositorVersion() >= 4;
+    const auto add_damage = [this, bufferDamage](const Rect &r) {
+        if (bufferDamage) wl_surface_damage_buffer(m_surface, r.x, r.y, r.width, r.height);
+        else wl_surface_damage(m_surface, r.x, r.y, r.width, r.height);
+    };
+
+    wl_surface_attach(m_surface, m_buf.buffer, 0, 0);
+    const bool full = m_fullDamage || !m_attached;
+    if (full) {
+        add_damage(Rect{.width = m_buf.width, .height = m_buf.height});
+    } else {
+        for (size_t i = 0; i < m_damageCount; ++i) add_damage(m_damage[i]);
+    }
+    m_parent->m_mgr.requestCommit(*this);
+
+    if (capture_impl::FrameCapture *capture = m_parent->m_mgr.capture()) {
+        std::array<capture_impl::CaptureRect, MAX_DAMAGE_RECTS> rects{};
+        size_t count = 0;
+        if (full) {
+            rects[count++] = capture_impl::CaptureRect{.width = m_buf.width, .height = m_buf.height};
+        } else {
+            for (; count < m_damageCount; ++count) {
+                const Rect &r = m_damage[count];
+                rects[count] = capture_impl::CaptureRect{.x = r.x, .y = r.y, .width = r.width, .height = r.height};
+            }
+        }
+        capture->submit(capture_impl::CaptureSurface{
+            .id = wl_proxy_get_id(reinterpret_cast<wl_proxy *>(m_surface)),
+            .parentId = wl_proxy_get_id(reinterpret_cast<wl_proxy *>(m_parent->surface())),
+            .x = m_x,
+            .y = m_y,
+            .width = m_buf.width,
+            .height = m_buf.height,
+            .stride = m_buf.stride,
+            .pixelFormat = WL_SHM_FORMAT_ARGB8888,
+            .pixels = m_buf.data.get(),
+        }, std::span(rects.data(), count));
+    }
+
+    m_attached = true;
+    m_busy = true;
+    m_fullDamage = false;
+    m_damageCount = 0;
+}
+
+void WaylandLayer::handle_buffer_release(void *data, wl_buffer *buffer)
+{
+    auto *self = static_cast<WaylandLayer *>(data);
+    (void)buffer;
+    self->m_busy = false;
+}
+
+} // namespace wm::wayland_impl
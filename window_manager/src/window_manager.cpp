@@ -1,25 +1,26 @@
 #include <memory>
 
 #include "window_manager/window_manager.hpp"
-#include "wayland/wayland_window_manager.hpp"
+#include "window_manager/wayland/wayland_window_manager.hpp"
 
 namespace wm {
 
-std::unique_ptr<WindowManager> WindowManager::createDefault()
+std::unique_ptr<WindowManager> WindowManager::createDefault(std::pmr::memory_resource *resource)
 {
 #ifdef WM_USE_VULKAN
     std::printf("[WindowManager] With support for vulkan, make sure you create the surface\n");
 #endif
 #if defined(__linux__)
-    return WindowManager::createWayland();
+    return WindowManager::createWayland(resource);
 #else
+    (void)resource;
     return nullptr;
 #endif
 }
 
-std::unique_ptr<WindowManager> WindowManager::createWayland()
+std::unique_ptr<WindowManager> WindowManager::createWayland(std::pmr::memory_resource *resource)
 {
-    return wayland_impl::WaylandWindowManager::create();
+    return wayland_impl::WaylandWindowManager::create(resource);
 }
 
 }